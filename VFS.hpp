@@ -33,17 +33,69 @@
 #include <algorithm>
 #include <string.h>
 #include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <queue>
+#include <thread>
+#include <sstream>
+#include <type_traits>
+#include <array>
+#include <limits>
+#include <cstdio>
+
+#if defined(__has_include) && __cplusplus >= 201703L
+    #if __has_include(<filesystem>)
+        #include <filesystem>
+        #define CVFS_HAS_FILESYSTEM
+    #endif
+#endif
+
+#if defined(__unix__)
+    #include <cerrno>
+    #include <fcntl.h>
+    #include <pthread.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+    #define CVFS_HAS_SHARED_MEMORY
+#endif
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    #include <nmmintrin.h>
+    #define CVFS_HAS_SSE42_CRC
+#endif
 
 namespace VFS
 {
     #define CHUNK_SIZE 4096
+    #define MAX_EXTENT_SIZE (4 * 1024 * 1024)
+    #define INLINE_SIZE 64
 
-    class CVFS;
-    class CVFSNode;
-    class CVFSFileStream;
+    struct MultiThreaded;
+    struct SingleThreaded;
+
+    template<class Policy> class CBasicVFS;
+    template<class Policy> class CBasicVFSNode;
+    template<class Policy> class CBasicVFSFileStream;
+    template<class Policy> class CBasicVFSListCursor;
+    class CSharedVFS;
+
+    using CVFS = CBasicVFS<MultiThreaded>;
+    using CVFSNode = CBasicVFSNode<MultiThreaded>;
+    using CVFSFileStream = CBasicVFSFileStream<MultiThreaded>;
+    using CVFSListCursor = CBasicVFSListCursor<MultiThreaded>;
+    using CSingleThreadedVFS = CBasicVFS<SingleThreaded>;
 
     using VFSNode = std::shared_ptr<CVFSNode>;
     using VFSFileStream = std::shared_ptr<CVFSFileStream>;
+    using VFSListCursor = std::shared_ptr<CVFSListCursor>;
 
     enum class VFSError
     {
@@ -56,7 +108,21 @@ namespace VFS
         NODE_ALREADY_EXISTS,
         NODE_DOESNT_EXISTS,
         FAILED_TO_READ_STREAM,
-        CANT_CREATE_FILESYSTEM
+        CANT_CREATE_FILESYSTEM,
+        FILESYSTEM_IS_READONLY,
+        HOST_IO_FAILED,
+        CHECKSUM_MISMATCH,
+        INVALID_HANDLE,
+        INVALID_DESTINATION
+    };
+
+    /**
+     * @brief When Deserialize verifies the checksums of the file data.
+     */
+    enum class VFSVerify
+    {
+        EAGER,  //!< While loading, the image is rejected on a mismatch.
+        LAZY    //!< On the first access of a file, which throws on a mismatch.
     };
 
     enum class FileMode
@@ -64,7 +130,8 @@ namespace VFS
         READ = 1,
         WRITE = 2,
         RW = (READ | WRITE),
-        APPEND = 4
+        APPEND = 4,
+        CONCURRENT_APPEND = (APPEND | 8)   //Appends without the lock of the file, for files which many threads append to. See CVFSFile::AppendConcurrent.
     };
 
     inline FileMode operator | (FileMode lhs, FileMode rhs)
@@ -96,6 +163,41 @@ namespace VFS
         END
     };
 
+    enum class VFSEvent
+    {
+        CREATE = 1,
+        WRITE = 2,
+        CLOSE_WRITE = 4,
+        RENAME = 8,
+        MOVE = 16,
+        DELETE = 32,
+        ALL = (CREATE | WRITE | CLOSE_WRITE | RENAME | MOVE | DELETE)
+    };
+
+    inline VFSEvent operator | (VFSEvent lhs, VFSEvent rhs)
+    {
+        return static_cast<VFSEvent>(static_cast<int>(lhs) | static_cast<int>(rhs));
+    }
+
+    inline VFSEvent operator & (VFSEvent lhs, VFSEvent rhs)
+    {
+        return static_cast<VFSEvent>(static_cast<int>(lhs) & static_cast<int>(rhs));
+    }
+
+    /**
+     * @brief Change notification of a watch.
+     */
+    struct SVFSEvent
+    {
+        uint64_t WatchID;
+        VFSEvent Type;
+        std::string Path;       //Path of the watched node at the time of CVFS::Watch.
+        std::string Name;       //Name of the changed child, empty if the watched node itself changed.
+        std::string NewName;    //New name of a renamed node.
+    };
+
+    using VFSWatchCallback = std::function<void(const SVFSEvent&)>;
+
     class CVFSException : public std::exception
     {
         public:
@@ -119,1190 +221,7504 @@ namespace VFS
     };
 
     /**
-     * @brief Base of all nodes.
+     * @brief CRC32C (Castagnoli) checksums. Uses the crc32 instruction of SSE4.2 if the cpu supports it.
      */
-    class CVFSNode
+    class CVFSCrc32c
     {
-        friend CVFS;
-
         public:
-            CVFSNode()
-            {
-                m_Created = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-                m_Accessed = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-            }
-
-            CVFSNode(const CVFSNode &node)
-            {
-                m_Name = node.m_Name;
-                m_IsDir = node.m_IsDir;
-
-                m_Created = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-                m_Accessed = node.m_Accessed;
-            }
-
             /**
-             * @return Gets the name of the node.
+             * @brief Continues a checksum.
+             * 
+             * @param Crc: Checksum of the previous data, 0 for the first call.
+             * @param Data: Data to add.
+             * @param Size: Size of the data.
+             * 
+             * @return Returns the checksum of the previous data and the given data.
              */
-            inline std::string Name() const
+            static uint32_t Update(uint32_t Crc, const void *Data, size_t Size)
             {
-                std::lock_guard<std::mutex> lock(m_UpdateLock);
-                return m_Name;
+#ifdef CVFS_HAS_SSE42_CRC
+                static const bool HARDWARE = __builtin_cpu_supports("sse4.2");
+                if(HARDWARE)
+                    return UpdateHardware(Crc, (const unsigned char*)Data, Size);
+#endif
+                return UpdateSoftware(Crc, (const unsigned char*)Data, Size);
             }
 
             /**
-             * @return Returns true if this node is a dir.
+             * @brief Copies data and continues the checksum of it in one pass, so the data is read only once.
+             * 
+             * @param Crc: Checksum of the previous data, 0 for the first call.
+             * @param Dest: Destination of the copy.
+             * @param Src: Data to copy and to add.
+             * @param Size: Size of the data.
+             * 
+             * @return Returns the checksum of the previous data and the given data.
              */
-            inline bool IsDir() const
+            static uint32_t Copy(uint32_t Crc, void *Dest, const void *Src, size_t Size)
             {
-                std::lock_guard<std::mutex> lock(m_UpdateLock);
-                return m_IsDir;
+#ifdef CVFS_HAS_SSE42_CRC
+                static const bool HARDWARE = __builtin_cpu_supports("sse4.2");
+                if(HARDWARE)
+                    return UpdateHardware<true>(Crc, (unsigned char*)Dest, (const unsigned char*)Src, Size);
+#endif
+                Crc = UpdateSoftware(Crc, (const unsigned char*)Src, Size);
+                memcpy(Dest, Src, Size);
+                return Crc;
             }
 
             /**
-             * @return Returns the creation time of the node.
+             * @return Returns the checksum of the given data.
              */
-            inline time_t Created() const
+            static uint32_t Compute(const void *Data, size_t Size)
             {
-                std::lock_guard<std::mutex> lock(m_UpdateLock);
-                return m_Created;
+                return Update(0, Data, Size);
             }
-            
-            /**
-             * @return Returns the last access time of the node.
-             */
-            inline time_t Accessed() const
+
+        private:
+            static const uint32_t POLYNOMIAL = 0x82F63B78;
+            static const size_t STRIPE_SIZE = 4096;
+
+            using ShiftTable = std::array<std::array<uint32_t, 256>, 4>;
+
+#ifdef CVFS_HAS_SSE42_CRC
+            static uint32_t UpdateHardware(uint32_t Crc, const unsigned char *Buf, size_t Size)
             {
-                std::lock_guard<std::mutex> lock(m_UpdateLock);
-                return m_Accessed;
+                return UpdateHardware<false>(Crc, nullptr, Buf, Size);
             }
 
             /**
-             * @return Returns a copy of this node.
+             * @brief The crc32 instruction has a latency of three cycles, so larger data is processed as three interleaved stripes.
+             * Their checksums are combined afterwards.
              */
-            virtual VFSNode Copy() = 0;
+            template<bool COPY>
+            __attribute__((target("sse4.2")))
+            static uint32_t UpdateHardware(uint32_t Crc, unsigned char *Dest, const unsigned char *Buf, size_t Size)
+            {
+                uint64_t Ret = ~Crc;
+                for (; Size > 0 && ((uintptr_t)Buf & 7) != 0; Size--)
+                {
+                    if(COPY)
+                        *Dest++ = *Buf;
+
+                    Ret = _mm_crc32_u8((uint32_t)Ret, *Buf++);
+                }
 
-            virtual ~CVFSNode() = default;
+                if(Size >= 3 * STRIPE_SIZE)
+                {
+                    static const ShiftTable One = Shift(STRIPE_SIZE);
+                    static const ShiftTable Two = Shift(2 * STRIPE_SIZE);
 
-        protected:
-            std::string m_Name;
-            bool m_IsDir;
+                    for (; Size >= 3 * STRIPE_SIZE; Size -= 3 * STRIPE_SIZE, Buf += 3 * STRIPE_SIZE)
+                    {
+                        uint64_t B = 0, C = 0;
+                        for (size_t i = 0; i < STRIPE_SIZE; i += 8)
+                        {
+                            uint64_t X, Y, Z;
+                            memcpy(&X, Buf + i, sizeof(X));
+                            memcpy(&Y, Buf + STRIPE_SIZE + i, sizeof(Y));
+                            memcpy(&Z, Buf + 2 * STRIPE_SIZE + i, sizeof(Z));
+                            Ret = _mm_crc32_u64(Ret, X);
+                            B = _mm_crc32_u64(B, Y);
+                            C = _mm_crc32_u64(C, Z);
+
+                            if(COPY)
+                            {
+                                memcpy(Dest + i, &X, sizeof(X));
+                                memcpy(Dest + STRIPE_SIZE + i, &Y, sizeof(Y));
+                                memcpy(Dest + 2 * STRIPE_SIZE + i, &Z, sizeof(Z));
+                            }
+                        }
 
-            time_t m_Created;
-            time_t m_Accessed;
+                        Ret = Apply(Two, (uint32_t)Ret) ^ Apply(One, (uint32_t)B) ^ (uint32_t)C;
+                        if(COPY)
+                            Dest += 3 * STRIPE_SIZE;
+                    }
+                }
 
-            mutable std::mutex m_UpdateLock;
-    };
+                for (; Size >= 8; Size -= 8, Buf += 8)
+                {
+                    uint64_t Value;
+                    memcpy(&Value, Buf, sizeof(Value));
+                    Ret = _mm_crc32_u64(Ret, Value);
 
-    class CVFS
-    {
-        friend CVFSFileStream;
+                    if(COPY)
+                    {
+                        memcpy(Dest, &Value, sizeof(Value));
+                        Dest += 8;
+                    }
+                }
 
-        public:
-            CVFS(/* args */) 
+                for (; Size > 0; Size--)
+                {
+                    if(COPY)
+                        *Dest++ = *Buf;
+
+                    Ret = _mm_crc32_u8((uint32_t)Ret, *Buf++);
+                }
+
+                return ~(uint32_t)Ret;
+            }
+#endif
+
+            static uint32_t Apply(const ShiftTable &Table, uint32_t Crc)
             {
-                //Creates the root node.
-                m_Root = VFSDir(new CVFSDir("/"));
+                return Table[0][Crc & 0xFF] ^ Table[1][(Crc >> 8) & 0xFF] ^ Table[2][(Crc >> 16) & 0xFF] ^ Table[3][Crc >> 24];
             }
 
             /**
-             * @brief Create a new directory.
-             * 
-             * @param Path: Path to the directory.
-             * @param Force: Creates all parent dirs, if they aren't exists.
-             * 
-             * @throw Throws a CVFSException, if the dir can't be created or the system is out of memory.
+             * @brief Builds the table, which advances a checksum over the given count of zero bytes. The operation is linear,
+             * so it is computed once for each bit and combined for each byte value.
              */
-            void CreateDir(const std::string &Path, bool Force = false)
+            static ShiftTable Shift(size_t Bytes)
             {
-                auto Dirs = SplitPath(Path);
-                auto CurDir = m_Root;
-
-                for (size_t i = 0; i < Dirs.size(); i++)
+                const auto &Table = Tables();
+                uint32_t Bits[32];
+                for (int i = 0; i < 32; i++)
                 {
-                    std::string Dir = Dirs[i];
+                    uint32_t Crc = uint32_t(1) << i;
+                    for (size_t j = 0; j < Bytes; j++)
+                        Crc = Table[0][Crc & 0xFF] ^ (Crc >> 8);
 
-                    auto node = CurDir->Search(Dir);
+                    Bits[i] = Crc;
+                }
 
-                    //Creates the directory either if Force is true or we are at the end of the path.
-                    if(!node && (Force || (i == Dirs.size() - 1)))
+                ShiftTable Ret;
+                for (int i = 0; i < 4; i++)
+                {
+                    for (uint32_t v = 0; v < 256; v++)
                     {
-                        VFSDir tmp;
-                        try
-                        {
-                            tmp = VFSDir(new CVFSDir(Dir));
-                            CurDir->AppendChild(tmp);
-                        }
-                        catch(const std::bad_alloc &e)
+                        uint32_t Crc = 0;
+                        for (int j = 0; j < 8; j++)
                         {
-                            throw CVFSException("Can't create directory. Out of mem. bad_alloc: " + std::string(e.what()), VFSError::OUT_OF_MEM);
+                            if(v & (1 << j))
+                                Crc ^= Bits[i * 8 + j];
                         }
-                        
-                        CurDir = tmp;
+
+                        Ret[i][v] = Crc;
                     }
-                    else if(!node || !node->IsDir())
-                        throw CVFSException("Can't create directory", VFSError::CANT_CREATE_DIR);
-                    else
-                        CurDir = std::static_pointer_cast<CVFSDir>(node);
-                }               
+                }
+
+                return Ret;
             }
 
             /**
-             * @return Gets the information of a given node. Returns null if the node wasn't found.
+             * @brief Slicing-by-8, processes 8 bytes per step with 8 lookup tables.
              */
-            VFSNode GetNodeInfo(const std::string &Path)
+            static uint32_t UpdateSoftware(uint32_t Crc, const unsigned char *Buf, size_t Size)
             {
-                auto Dirs = SplitPath(Path);
-                auto CurDir = m_Root;
-                VFSNode Ret;
-                if(Path == "/")
-                    Ret = m_Root;
-
-                for (size_t i = 0; i < Dirs.size(); i++)
+                static const auto &Table = Tables();
+                uint32_t Ret = ~Crc;
+                for (; Size >= 8; Size -= 8, Buf += 8)
                 {
-                    std::string Dir = Dirs[i];
+                    uint32_t Low = Ret ^ (Buf[0] | (Buf[1] << 8) | (Buf[2] << 16) | ((uint32_t)Buf[3] << 24));
+                    Ret = Table[7][Low & 0xFF] ^ Table[6][(Low >> 8) & 0xFF] ^ Table[5][(Low >> 16) & 0xFF] ^ Table[4][Low >> 24] ^
+                          Table[3][Buf[4]] ^ Table[2][Buf[5]] ^ Table[1][Buf[6]] ^ Table[0][Buf[7]];
+                }
 
-                    auto node = CurDir->Search(Dir);
-                    if(node && (node->IsDir() || (i == Dirs.size() - 1)))   //"Go into" the directory. 
-                    {
-                        Ret = node;
-                        CurDir = std::static_pointer_cast<CVFSDir>(node);
-                    }
-                    else
+                for (; Size > 0; Size--)
+                    Ret = Table[0][(Ret ^ *Buf++) & 0xFF] ^ (Ret >> 8);
+
+                return ~Ret;
+            }
+
+            static const std::array<std::array<uint32_t, 256>, 8> &Tables()
+            {
+                static const auto Ret = []()
+                {
+                    std::array<std::array<uint32_t, 256>, 8> Table;
+                    for (uint32_t i = 0; i < 256; i++)
                     {
-                        Ret = nullptr;
-                        break;
+                        uint32_t Crc = i;
+                        for (int j = 0; j < 8; j++)
+                            Crc = (Crc >> 1) ^ ((Crc & 1) ? POLYNOMIAL : 0);
+
+                        Table[0][i] = Crc;
                     }
-                }
+
+                    for (uint32_t i = 0; i < 256; i++)
+                        for (int j = 1; j < 8; j++)
+                            Table[j][i] = (Table[j - 1][i] >> 8) ^ Table[0][Table[j - 1][i] & 0xFF];
+
+                    return Table;
+                }();
 
                 return Ret;
             }
+    };
+
+    /**
+     * @brief Reads and writes the headers of tar archives in the ustar format with pax extensions, see CVFS::ImportTar.
+     */
+    class CVFSTar
+    {
+        public:
+            static const size_t BLOCK_SIZE = 512;
 
             /**
-             * @return Checks if a given node already exists. Return true if the node exists.
+             * @brief Entry of an archive.
              */
-            bool NodeExists(const std::string &Path)
+            struct SEntry
             {
-                return GetNodeInfo(Path) != nullptr; 
-            }
+                std::string Path;
+                uint64_t Size;
+                time_t Modified;
+                char Type;      //!< Type flag of the header, e.g. '0' for files and '5' for directories.
+            };
 
             /**
-             * @return Gets a list of the content of a directory.
+             * @brief Parses a header block.
              * 
-            * @throw Throws a CVFSException, if the given node is a file.
+             * @param Block: Header of BLOCK_SIZE bytes.
+             * @param Entry: Receives the entry.
+             * 
+             * @return Returns false for an empty block, which marks the end of the archive.
+             * 
+             * @throw Throws a CVFSException, if the checksum of the header doesn't match.
              */
-            std::vector<VFSNode> List(const std::string &Path)
+            static bool ParseHeader(const char *Block, SEntry &Entry)
             {
-                auto node = GetNodeInfo(Path);
-                return List(node);
+                const unsigned char *Bytes = (const unsigned char*)Block;
+                uint64_t Sum = 0;
+                int64_t SignedSum = 0;  //Some old archivers sum signed bytes.
+                bool Empty = true;
+                for (size_t i = 0; i < BLOCK_SIZE; i++)
+                {
+                    unsigned char c = (i >= 148 && i < 156) ? ' ' : Bytes[i];
+                    Sum += c;
+                    SignedSum += (signed char)c;
+                    Empty = Empty && Bytes[i] == 0;
+                }
+
+                if(Empty)
+                    return false;
+
+                uint64_t Checksum = ParseNumber(Block + 148, 8);
+                if(Checksum != Sum && (int64_t)Checksum != SignedSum)
+                    throw CVFSException("Can't read archive. Checksum mismatch of a header.", VFSError::CHECKSUM_MISMATCH);
+
+                Entry.Path = Field(Block, 100);
+                if(memcmp(Block + 257, "ustar", 6) == 0 && Block[345])
+                    Entry.Path = Field(Block + 345, 155) + "/" + Entry.Path;
+
+                Entry.Size = ParseNumber(Block + 124, 12);
+                Entry.Modified = (time_t)ParseNumber(Block + 136, 12);
+                Entry.Type = Block[156];
+                return true;
             }
 
             /**
-             * @return Gets a list of the content of a directory.
-             * 
-             * @throw Throws a CVFSException, if the given node is a file.
+             * @brief Applies the records of a pax extended header to an entry.
              */
-            std::vector<VFSNode> List(VFSNode node)
+            static void ParsePax(const std::string &Records, SEntry &Entry)
             {
-                std::vector<VFSNode> Ret;
-                if(node && node->IsDir())
+                size_t Pos = 0;
+                while (Pos < Records.size())
                 {
-                    auto Dir = std::static_pointer_cast<CVFSDir>(node);
-                    Ret = Dir->GetChilds();
-                }
-                else if(node && !node->IsDir())
-                    throw CVFSException("Given node is not a directory", VFSError::NODE_IS_FILE);
+                    //Each record is "<length> <key>=<value>\n", the length includes the whole record.
+                    size_t Space = Records.find(' ', Pos);
+                    if(Space == std::string::npos)
+                        break;
 
-                return Ret;
+                    size_t Length = std::strtoull(Records.c_str() + Pos, nullptr, 10);
+                    size_t Equal = Records.find('=', Space);
+                    if(Length == 0 || Pos + Length > Records.size() || Equal == std::string::npos || Equal >= Pos + Length)
+                        throw CVFSException("Can't read archive. Invalid pax header.", VFSError::FAILED_TO_READ_STREAM);
+
+                    std::string Key = Records.substr(Space + 1, Equal - Space - 1);
+                    std::string Value = Records.substr(Equal + 1, Pos + Length - Equal - 2);
+                    if(Key == "path")
+                        Entry.Path = Value;
+                    else if(Key == "size")
+                        Entry.Size = std::strtoull(Value.c_str(), nullptr, 10);
+                    else if(Key == "mtime")
+                        Entry.Modified = (time_t)std::strtoll(Value.c_str(), nullptr, 10);
+
+                    Pos += Length;
+                }
             }
 
             /**
-             * @brief Creates or opens a file.
-             * 
-             * @param Path: Path to the file.
-             * @param mode: Access mode.
+             * @brief Writes a header block. Paths and sizes which don't fit into the ustar fields need a pax header before, see PaxRecords.
              * 
-             * @throw Throws a CVFSException, if the given node is a directory or if the file can't opened for readonly.
+             * @param Block: Receives BLOCK_SIZE bytes.
+             * @param Type: Type flag of the entry.
              */
-            VFSFileStream Open(const std::string &Path, FileMode mode);
+            static void FormatHeader(char *Block, const std::string &Path, uint64_t Size, time_t Modified, char Type)
+            {
+                memset(Block, 0, BLOCK_SIZE);
+
+                std::string Prefix, Name = Path;
+                SplitName(Path, Prefix, Name);
+                memcpy(Block, Name.data(), std::min(Name.size(), (size_t)100));
+                memcpy(Block + 345, Prefix.data(), std::min(Prefix.size(), (size_t)155));
+
+                FormatNumber(Block + 100, 8, Type == '5' ? 0755 : 0644);
+                FormatNumber(Block + 108, 8, 0);
+                FormatNumber(Block + 116, 8, 0);
+                FormatNumber(Block + 124, 12, FitsNumber(Size, 12) ? Size : 0);
+                FormatNumber(Block + 136, 12, Modified > 0 && FitsNumber(Modified, 12) ? Modified : 0);
+                Block[156] = Type;
+                memcpy(Block + 257, "ustar", 6);
+                memcpy(Block + 263, "00", 2);
+
+                memset(Block + 148, ' ', 8);
+                uint64_t Sum = 0;
+                for (size_t i = 0; i < BLOCK_SIZE; i++)
+                    Sum += (unsigned char)Block[i];
+
+                FormatNumber(Block + 148, 7, Sum);
+            }
 
             /**
-             * @return Returns the file size.
+             * @return Returns the pax records for the fields of an entry, which don't fit into the ustar header. Returns an empty string if all fields fit.
              */
-            size_t FileSize(VFSNode node)
+            static std::string PaxRecords(const std::string &Path, uint64_t Size)
             {
-                if(!node->IsDir())
-                {
-                    auto file = std::static_pointer_cast<CVFSFile>(node);
-                    return file->Size();
-                }
-                else if(node && !node->IsDir())
-                    throw CVFSException("Given node is not a file.", VFSError::NODE_IS_DIR);
+                std::string Ret;
+                std::string Prefix, Name;
+                if(!SplitName(Path, Prefix, Name))
+                    Ret += PaxRecord("path", Path);
 
-                return 0;
+                if(!FitsNumber(Size, 12))
+                    Ret += PaxRecord("size", std::to_string(Size));
+
+                return Ret;
             }
 
             /**
-             * @brief Renames a node.
-             * 
-             * @param Path: Path to the node.
-             * @param Name: New Name of the node.
-             * 
-             * @throw Throws a CVFSException, if a node with the given name already exists or the node doesn't exists.
+             * @return Returns the count of padding bytes after data of the given size.
              */
-            void Rename(const std::string &Path, const std::string &Name)
+            static inline size_t Padding(uint64_t Size)
             {
-                if(NodeExists(Path))
-                {
-                    if(!NodeExists(ExtractPath(Path) + "/" + Name))
-                    {
-                        auto Parent = std::static_pointer_cast<CVFSDir>(GetNodeInfo(ExtractPath(Path)));
-                        Parent->RenameChild(ExtractName(Path), Name);
-                    }
-                    else
-                        throw CVFSException("Can't rename node. Node already exists.", VFSError::NODE_ALREADY_EXISTS);
-                }
-                else
-                    throw CVFSException("Can't rename node. Node doesn't exists.", VFSError::NODE_DOESNT_EXISTS);
+                return (BLOCK_SIZE - Size % BLOCK_SIZE) % BLOCK_SIZE;
+            }
+
+        private:
+            /**
+             * @return Returns a field, which is terminated by a null or the end of the field.
+             */
+            static std::string Field(const char *Data, size_t Size)
+            {
+                return std::string(Data, strnlen(Data, Size));
             }
 
             /**
-             * @brief Moves a node.
-             * 
-             * @param From: The node to move.
-             * @param To: Desitination of the node.
-             * 
-             * @throw Throws a CVFSException on error.
+             * @brief Parses an octal number or a base-256 number, which is marked by the highest bit of the first byte.
              */
-            void Move(const std::string &From, const std::string &To)
+            static uint64_t ParseNumber(const char *Data, size_t Size)
             {
-                if(!NodeExists(From))
-                    throw CVFSException("Can't move node. Source node doesn't exists.", VFSError::NODE_DOESNT_EXISTS);
+                uint64_t Ret = 0;
+                if(Data[0] & 0x80)
+                {
+                    Ret = Data[0] & 0x7F;
+                    for (size_t i = 1; i < Size; i++)
+                        Ret = (Ret << 8) | (unsigned char)Data[i];
 
-                if(!NodeExists(To))
-                    throw CVFSException("Can't move node. Destination node doesn't exists.", VFSError::NODE_DOESNT_EXISTS);
+                    return Ret;
+                }
 
-                auto DestNode = GetNodeInfo(To);
-                if(!DestNode->IsDir())
-                    throw CVFSException("Can't move node. Destination node is a file.", VFSError::NODE_IS_FILE);
+                size_t i = 0;
+                while (i < Size && (Data[i] == ' ' || Data[i] == 0))
+                    i++;
 
-                auto node = GetNodeInfo(From);
-                auto SrcParent = std::static_pointer_cast<CVFSDir>(GetNodeInfo(ExtractPath(From)));
-                auto DestParent = std::static_pointer_cast<CVFSDir>(DestNode);
+                for (; i < Size && Data[i] >= '0' && Data[i] <= '7'; i++)
+                    Ret = (Ret << 3) | (uint64_t)(Data[i] - '0');
 
-                SrcParent->RemoveChild(node->Name());
-                DestParent->AppendChild(node);
+                return Ret;
             }
 
             /**
-             * @brief Deletes a node.
-             * 
-             * @throw Throws a CVFSException on error.
+             * @brief Writes a null terminated octal number with leading zeros.
              */
-            void Delete(const std::string &Path)
+            static void FormatNumber(char *Data, size_t Size, uint64_t Value)
             {
-                if(!NodeExists(Path))
-                    throw CVFSException("Can't delete node. Node doesn't exists.", VFSError::NODE_DOESNT_EXISTS);
-
-                auto node = GetNodeInfo(Path);
-                auto Parent = std::static_pointer_cast<CVFSDir>(GetNodeInfo(ExtractPath(Path)));
+                Data[Size - 1] = 0;
+                for (size_t i = Size - 1; i > 0; i--)
+                {
+                    Data[i - 1] = (char)('0' + (Value & 7));
+                    Value >>= 3;
+                }
+            }
 
-                Parent->RemoveChild(node->Name());
+            /**
+             * @return Returns true if the value fits as octal number into a field.
+             */
+            static inline bool FitsNumber(uint64_t Value, size_t Size)
+            {
+                return (Size - 1) * 3 >= 64 || (Value >> ((Size - 1) * 3)) == 0;
             }
 
             /**
-             * @brief Copies a node.
+             * @brief Splits a path into the prefix and name fields of the ustar header.
              * 
-             * @param From: The node to copy.
-             * @param To: Desitination of the copy.
-             * 
-             * @throw Throws a CVFSException on error.
+             * @return Returns false if the path doesn't fit, the fields then receive a truncated path.
              */
-            void Copy(const std::string &From, const std::string &To)
+            static bool SplitName(const std::string &Path, std::string &Prefix, std::string &Name)
             {
-                if(!NodeExists(From))
-                    throw CVFSException("Can't copy node. Source node doesn't exists.", VFSError::NODE_DOESNT_EXISTS);
+                Prefix.clear();
+                Name = Path;
+                if(Path.size() <= 100)
+                    return true;
+
+                //The prefix ends at a slash, which isn't part of both fields.
+                size_t Pos = Path.find('/', Path.size() > 101 ? Path.size() - 101 : 0);
+                if(Pos != std::string::npos && Pos > 0 && Pos <= 155)
+                {
+                    Prefix = Path.substr(0, Pos);
+                    Name = Path.substr(Pos + 1);
+                    return true;
+                }
 
-                if(NodeExists(To))
-                    throw CVFSException("Can't copy node. Destination node already exists.", VFSError::NODE_ALREADY_EXISTS);
+                Name = Path.substr(0, 100);
+                return false;
+            }
 
-                auto DestNode = GetNodeInfo(ExtractPath(To));
-                if(!DestNode->IsDir())
-                    throw CVFSException("Can't copy node. Destination node parent is a file.", VFSError::NODE_IS_FILE);
+            /**
+             * @return Returns a pax record, which length field includes its own digits.
+             */
+            static std::string PaxRecord(const std::string &Key, const std::string &Value)
+            {
+                size_t Length = Key.size() + Value.size() + 3;
+                size_t Digits = std::to_string(Length).size();
+                if(std::to_string(Length + Digits).size() != Digits)
+                    Digits++;
 
-                auto node = GetNodeInfo(From);
-                auto DestParent = std::static_pointer_cast<CVFSDir>(DestNode);
+                return std::to_string(Length + Digits) + " " + Key + "=" + Value + "\n";
+            }
+    };
 
-                auto copy = node->Copy();
-                copy->m_Name = ExtractName(To);
+    /**
+     * @brief Operations which are measured by the statistics.
+     */
+    enum class VFSOp
+    {
+        OPEN,
+        READ,
+        WRITE,
+        LOOKUP,
+        SERIALIZE,
+        DESERIALIZE,
+        COUNT
+    };
 
-                DestParent->AppendChild(copy);
-            }
+    /**
+     * @brief Point-in-time copy of the statistics, returned by CVFS::Stats().
+     */
+    struct SVFSStats
+    {
+        struct SOperation
+        {
+            uint64_t Count = 0;
+            uint64_t TotalNs = 0;
+            uint64_t P50Ns = 0;
+            uint64_t P90Ns = 0;
+            uint64_t P99Ns = 0;
+            uint64_t MaxNs = 0;
+        };
+
+        bool Enabled = false;   //False if the library is compiled without CVFS_ENABLE_STATS.
+        SOperation Ops[(int)VFSOp::COUNT];
+
+        uint64_t BytesRead = 0;
+        uint64_t BytesWritten = 0;
+
+        uint64_t LockAcquisitions = 0;
+        uint64_t LockContentions = 0;
+        uint64_t LockWaitNs = 0;
+
+        int64_t LiveNodes = 0;
+        int64_t LiveChunks = 0;
+        int64_t ChunkBytes = 0;
+
+        std::vector<std::pair<std::string, uint64_t>> HotDirs;  //Directories with the most lock contentions.
+
+        /**
+         * @return Returns the name of an operation.
+         */
+        static const char *OpName(VFSOp Op)
+        {
+            static const char *Names[] = {"open", "read", "write", "lookup", "serialize", "deserialize"};
+            return Names[(int)Op];
+        }
 
-            /**
-             * @return Returns the complete filesystem as stream.
-             * 
-             * @attention This function allocates new memory for saving the filesystem.
-             * @throw Throws a CVFSException on out of memory.
-             */
-            std::vector<char> Serialize()
+        /**
+         * @return Returns the statistics as human readable text.
+         */
+        std::string ToString() const
+        {
+            std::stringstream Ret;
+            for (int i = 0; i < (int)VFSOp::COUNT; i++)
             {
-                try
-                {
-                    VFSFile Disk = VFSFile(new CVFSFile("stream"));
-                    Disk->Clear();
-                    Disk->Write(MAGIC.data(), MAGIC.size());
+                auto &e = Ops[i];
+                Ret << OpName((VFSOp)i) << ": count=" << e.Count << " total=" << e.TotalNs << "ns p50=" << e.P50Ns << "ns p90=" << e.P90Ns
+                    << "ns p99=" << e.P99Ns << "ns max=" << e.MaxNs << "ns\n";
+            }
 
-                    uint64_t Entries = m_Root->GetChilds().size();
-                    Disk->Write((char*)&Entries, sizeof(Entries));
-                    FillSpace(Disk.get(), DISK_CHUNK_SIZE - (MAGIC.size() + sizeof(Entries)));
+            Ret << "bytes: read=" << BytesRead << " written=" << BytesWritten << "\n";
+            Ret << "locks: acquisitions=" << LockAcquisitions << " contentions=" << LockContentions << " wait=" << LockWaitNs << "ns\n";
+            Ret << "live: nodes=" << LiveNodes << " chunks=" << LiveChunks << " chunk_bytes=" << ChunkBytes << "\n";
 
-                    auto Childs = m_Root->GetChilds();
-                    for (auto e : Childs)
-                        SerializeNode(Disk.get(), e.get());
+            for (auto &&e : HotDirs)
+                Ret << "hot dir: " << e.first << " contentions=" << e.second << "\n";
 
-                    std::vector<char> Ret;
-                    Ret.resize(Disk->Size());
-                    Disk->Read(&Ret[0], Disk->Size(), 0);
-                    return Ret;
-                }
-                catch(const std::bad_alloc &e)
-                {
-                    throw CVFSException("Can't create stream. Out of mem. bad_alloc: " + std::string(e.what()), VFSError::OUT_OF_MEM);
-                }
+            return Ret.str();
+        }
+
+        /**
+         * @return Returns the statistics as JSON object.
+         */
+        std::string ToJSON() const
+        {
+            std::stringstream Ret;
+            Ret << "{\"enabled\": " << (Enabled ? "true" : "false") << ", \"ops\": {";
+            for (int i = 0; i < (int)VFSOp::COUNT; i++)
+            {
+                auto &e = Ops[i];
+                Ret << (i ? ", " : "") << "\"" << OpName((VFSOp)i) << "\": {\"count\": " << e.Count << ", \"total_ns\": " << e.TotalNs
+                    << ", \"p50_ns\": " << e.P50Ns << ", \"p90_ns\": " << e.P90Ns << ", \"p99_ns\": " << e.P99Ns << ", \"max_ns\": " << e.MaxNs << "}";
             }
 
-            /**
-             * @return Returns the complete filesystem as stream.
-             * 
-             * @attention This function allocates new memory for saving the filesystem.
-             * @throw Throws a CVFSException on out of memory.
-             */
-            void Deserialize(const std::vector<char> &Data)
+            Ret << "}, \"bytes_read\": " << BytesRead << ", \"bytes_written\": " << BytesWritten;
+            Ret << ", \"lock_acquisitions\": " << LockAcquisitions << ", \"lock_contentions\": " << LockContentions << ", \"lock_wait_ns\": " << LockWaitNs;
+            Ret << ", \"live_nodes\": " << LiveNodes << ", \"live_chunks\": " << LiveChunks << ", \"chunk_bytes\": " << ChunkBytes;
+            Ret << ", \"hot_dirs\": [";
+            for (size_t i = 0; i < HotDirs.size(); i++)
             {
-                try
+                std::string Path;
+                for (char c : HotDirs[i].first)
                 {
-                    size_t Pos = 0;
-                    uint64_t Entries = 0;
-                    std::string FileMagic;
-                    FileMagic.resize(MAGIC.size());
+                    if(c == '"' || c == '\\')
+                        Path += '\\';
+                    Path += c;
+                }
 
-                    ReadVector(Data, &FileMagic[0], FileMagic.size(), Pos);
-                    if(FileMagic != MAGIC)
-                        throw CVFSException("Can't create filesystem.", VFSError::CANT_CREATE_FILESYSTEM);
+                Ret << (i ? ", " : "") << "{\"path\": \"" << Path << "\", \"contentions\": " << HotDirs[i].second << "}";
+            }
 
-                    ReadVector(Data, (char*)&Entries, sizeof(Entries), Pos);
+            Ret << "]}";
+            return Ret.str();
+        }
+    };
 
-                    //Skips the sector.
-                    Pos += (DISK_CHUNK_SIZE - (MAGIC.size() + sizeof(Entries)));
+    /**
+     * @brief Memory usage of a filesystem, returned by CVFS::MemoryReport().
+     */
+    struct SVFSMemoryReport
+    {
+        struct SWaster
+        {
+            std::string Path;
+            uint64_t LiveBytes = 0;
+            uint64_t AllocatedBytes = 0;
+        };
+
+        uint64_t Dirs = 0;
+        uint64_t Files = 0;
+        uint64_t Chunks = 0;
+
+        uint64_t LiveBytes = 0;         //Size of all files.
+        uint64_t AllocatedBytes = 0;    //Chunk memory of all files. Chunks which are shared between files are counted once.
+        uint64_t WastedBytes = 0;       //Allocated but unused bytes of the extents of all files, which Compact can release.
+        uint64_t ReservedBytes = 0;     //Storage of Reserve, which isn't used yet.
+        uint64_t NodeBytes = 0;         //Nodes, names, child and extent vectors and chunk headers.
+
+        std::vector<SWaster> Wasters;   //Files with the most unused bytes, largest first.
+
+        /**
+         * @return Returns the report as human readable text.
+         */
+        std::string ToString() const
+        {
+            std::stringstream Ret;
+            Ret << "nodes: dirs=" << Dirs << " files=" << Files << " chunks=" << Chunks << " node_bytes=" << NodeBytes << "\n";
+            Ret << "data: live=" << LiveBytes << " allocated=" << AllocatedBytes << " wasted=" << WastedBytes << " reserved=" << ReservedBytes << "\n";
 
-                    for (size_t i = 0; i < Entries; i++)
-                        m_Root->AppendChild(DeserializeNode(Data, Pos));
-                
-                    // SerializeNode(Disk.get(), m_Root.get());
-                }
-                catch(const std::bad_alloc &e)
+            for (auto &&e : Wasters)
+                Ret << "waster: " << e.Path << " live=" << e.LiveBytes << " allocated=" << e.AllocatedBytes << "\n";
+
+            return Ret.str();
+        }
+
+        /**
+         * @return Returns the report as JSON object.
+         */
+        std::string ToJSON() const
+        {
+            std::stringstream Ret;
+            Ret << "{\"dirs\": " << Dirs << ", \"files\": " << Files << ", \"chunks\": " << Chunks << ", \"node_bytes\": " << NodeBytes;
+            Ret << ", \"live_bytes\": " << LiveBytes << ", \"allocated_bytes\": " << AllocatedBytes << ", \"wasted_bytes\": " << WastedBytes << ", \"reserved_bytes\": " << ReservedBytes;
+            Ret << ", \"wasters\": [";
+            for (size_t i = 0; i < Wasters.size(); i++)
+            {
+                std::string Path;
+                for (char c : Wasters[i].Path)
                 {
-                    throw CVFSException("Can't create filesystem. Out of mem. bad_alloc: " + std::string(e.what()), VFSError::OUT_OF_MEM);
+                    if(c == '"' || c == '\\')
+                        Path += '\\';
+                    Path += c;
                 }
+
+                Ret << (i ? ", " : "") << "{\"path\": \"" << Path << "\", \"live_bytes\": " << Wasters[i].LiveBytes << ", \"allocated_bytes\": " << Wasters[i].AllocatedBytes << "}";
             }
 
-            size_t ReadVector(const std::vector<char> &Data, char *Buf, size_t Size, size_t &Pos)
+            Ret << "]}";
+            return Ret.str();
+        }
+    };
+
+#ifdef CVFS_ENABLE_STATS
+    /**
+     * @brief Log-linear latency histogram, values are kept with a precision of 1/16 of their power of two.
+     */
+    class CVFSHistogram
+    {
+        public:
+            CVFSHistogram()
             {
-                size_t CopyCount = (Pos + Size) < Data.size() ? Size : (Data.size() - Pos);
-                if(CopyCount > Data.size())
-                   throw CVFSException("Can't create filesystem.", VFSError::FAILED_TO_READ_STREAM);
+                Reset();
+            }
 
-                memcpy(Buf, Data.data() + Pos, CopyCount);
-                Pos += CopyCount;
+            inline void Add(uint64_t Value)
+            {
+                m_Buckets[Index(Value)].fetch_add(1, std::memory_order_relaxed);
+                m_Count.fetch_add(1, std::memory_order_relaxed);
+                m_Total.fetch_add(Value, std::memory_order_relaxed);
 
-                return CopyCount;
+                uint64_t Max = m_Max.load(std::memory_order_relaxed);
+                while (Value > Max && !m_Max.compare_exchange_weak(Max, Value, std::memory_order_relaxed));
             }
 
-            ~CVFS() {}
-        private:
-            const std::string MAGIC = "CVFS-DISK";
-            const int DISK_CHUNK_SIZE = 128;
-            const std::string NODE_IDENTIFIER = "NODE";
+            void Reset()
+            {
+                for (auto &&e : m_Buckets)
+                    e = 0;
 
-            class CVFSFile;
-            class CVFSDir;
+                m_Count = 0;
+                m_Total = 0;
+                m_Max = 0;
+            }
 
-            using VFSFile = std::shared_ptr<CVFSFile>;
-            using VFSDir = std::shared_ptr<CVFSDir>;
-            
-            class CVFSFile : public CVFSNode
+            void Get(SVFSStats::SOperation &Op) const
             {
-                friend CVFS;
+                Op.Count = m_Count.load(std::memory_order_relaxed);
+                Op.TotalNs = m_Total.load(std::memory_order_relaxed);
+                Op.MaxNs = m_Max.load(std::memory_order_relaxed);
 
-                public:
-                    CVFSFile() : CVFSNode()
-                    {
-                        m_IsDir = false;
-                        m_Modified = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-                        m_Size = 0;
-                    }
+                uint64_t Seen = 0;
+                uint64_t Count = 0;
+                for (auto &&e : m_Buckets)
+                    Count += e.load(std::memory_order_relaxed);
 
-                    CVFSFile(const std::string &Name) : CVFSFile()
-                    {
-                        m_Name = Name;
-                    }
+                uint64_t *Targets[] = {&Op.P50Ns, &Op.P90Ns, &Op.P99Ns};
+                double Quantiles[] = {0.5, 0.9, 0.99};
+                size_t Next = 0;
 
-                    CVFSFile(const CVFSFile &file) : CVFSNode(file)
-                    {
-                        m_Modified = file.m_Modified;
-                        m_Size = file.m_Size;
+                for (size_t i = 0; i < BUCKETS && Next < 3; i++)
+                {
+                    Seen += m_Buckets[i].load(std::memory_order_relaxed);
+                    while (Next < 3 && Count > 0 && Seen >= Quantiles[Next] * Count)
+                        *Targets[Next++] = std::min(UpperBound(i), Op.MaxNs);
+                }
+            }
 
-                        ReserveChunks(file.m_Data.size());
+        private:
+            static const size_t SUB_BUCKETS = 16;
+            static const size_t BUCKETS = SUB_BUCKETS + 60 * SUB_BUCKETS;
 
-                        //Copies the data content.
-                        for (size_t i = 0; i < file.m_Data.size(); i++)
-                        {
-                            Chunk s = file.m_Data[i];
-                            Chunk d = m_Data[i];
+            static inline size_t Index(uint64_t Value)
+            {
+                if(Value < SUB_BUCKETS)
+                    return Value;
 
-                            d->Filled = s->Filled;
-                            memcpy(d->Data, s->Data, s->Filled);
-                        }
-                    }
+                size_t Exp = 0;
+                for (uint64_t v = Value; v > 1; v >>= 1)
+                    Exp++;
 
-                    /**
-                     * @brief Clears the file.
-                     */
-                    void Clear()
-                    {
-                        std::lock_guard<std::mutex> lock(m_UpdateLock);
-                        m_Data.clear();
-                        ReserveChunks(4);
-                    }
+                return SUB_BUCKETS + (Exp - 4) * SUB_BUCKETS + ((Value >> (Exp - 4)) - SUB_BUCKETS);
+            }
 
-                    /**
-                     * @brief Writes data to the file.
-                     * 
-                     * @param Data: Data to write.
-                     * @param Size: Size of the data.
-                     * 
-                     * @return Returns the size which was written.
-                     */
-                    size_t Write(const char *Data, size_t Size)
-                    {
-                        std::lock_guard<std::mutex> lock(m_UpdateLock);
+            static inline uint64_t UpperBound(size_t Index)
+            {
+                if(Index < SUB_BUCKETS)
+                    return Index;
 
-                        //Calculates the chunk count which is needed to save the data.
-                        size_t ChunkCount = Size / CHUNK_SIZE + ((Size % CHUNK_SIZE > 0) ? 1 : 0);
-                        if(((m_Size + Size) >= (m_Data.size() * CHUNK_SIZE)))    //Allocate new chunks, if we are exhausted.
-                            ReserveChunks(ChunkCount);
+                size_t Exp = (Index - SUB_BUCKETS) / SUB_BUCKETS + 4;
+                uint64_t Sub = (Index - SUB_BUCKETS) % SUB_BUCKETS + SUB_BUCKETS;
+                return ((Sub + 1) << (Exp - 4)) - 1;
+            }
 
-                        size_t Written = 0;
-                        size_t ChunkPos = m_Size / CHUNK_SIZE;  //Calculates the beginning chunk.
+            std::atomic<uint64_t> m_Buckets[BUCKETS];
+            std::atomic<uint64_t> m_Count;
+            std::atomic<uint64_t> m_Total;
+            std::atomic<uint64_t> m_Max;
+    };
 
-                        while (Written < Size)
-                        {
-                            Chunk c = m_Data[ChunkPos];
-                            size_t Free = c->Size - c->Filled;
-                            size_t CopyCount = ((Size - Written) >= Free) ? Free : (Size - Written);    //Calculate the right copy size.
+    /**
+     * @brief Process wide counters of all filesystems.
+     */
+    struct SVFSCounters
+    {
+        CVFSHistogram Ops[(int)VFSOp::COUNT];
 
-                            memcpy(c->Data + c->Filled, Data + Written, CopyCount);
-                            c->Filled += CopyCount; //Chunk update
-                            m_Size += CopyCount;  
-                            Written += CopyCount;
-                            ChunkPos++;
-                        }
+        std::atomic<uint64_t> BytesRead{0};
+        std::atomic<uint64_t> BytesWritten{0};
 
-                        m_Modified = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-                        return Written;
-                    }
+        std::atomic<uint64_t> LockAcquisitions{0};
+        std::atomic<uint64_t> LockContentions{0};
+        std::atomic<uint64_t> LockWaitNs{0};
 
-                    /**
-                     * @brief Reads data from the file.
-                     * 
-                     * @param Buf: Buffer which receives the data.
-                     * @param Size: Size of the buffer.
-                     * @param CurPos: Position of inside the file.
-                     * 
-                     * @return Returns the size which was readed.
-                     */
-                    size_t Read(char *Buf, size_t Size, size_t CurPos)
-                    {
-                        std::lock_guard<std::mutex> lock(m_UpdateLock);
+        std::atomic<int64_t> LiveNodes{0};
+        std::atomic<int64_t> LiveChunks{0};
+        std::atomic<int64_t> ChunkBytes{0};
 
-                        size_t ChunkPos = CurPos / CHUNK_SIZE; //Calculates the beginning chunk.
-                        size_t Readed = 0;
+        static SVFSCounters &Instance()
+        {
+            static SVFSCounters Counters;
+            return Counters;
+        }
+    };
 
-                        while (Readed < Size)
-                        {
-                            if(ChunkPos >= m_Data.size())
-                                break;
+    /**
+     * @brief Measures the time of an operation until the end of the scope.
+     */
+    class CVFSStatsTimer
+    {
+        public:
+            CVFSStatsTimer(VFSOp Op) : m_Op(Op), m_Start(std::chrono::steady_clock::now()) {}
 
-                            Chunk c = m_Data[ChunkPos];
-                            size_t Pos = CurPos - ChunkPos * CHUNK_SIZE;
-                            Pos = (Pos > CHUNK_SIZE) ? 0 : Pos;
+            ~CVFSStatsTimer()
+            {
+                auto Time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_Start).count();
+                SVFSCounters::Instance().Ops[(int)m_Op].Add(Time);
+            }
 
-                            int CopyCount = c->Filled - Pos;
-                            CopyCount = CopyCount > Size ? Size : CopyCount;    //Calculate the right copy size.
-                            if(CopyCount <= 0)
-                                break;
+        private:
+            VFSOp m_Op;
+            std::chrono::steady_clock::time_point m_Start;
+    };
 
-                            memcpy(Buf + Readed, c->Data + Pos, CopyCount);
-                            Readed += CopyCount;
-                            ChunkPos++;
-                        }
-                        
-                        m_Accessed = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-                        return Readed;
-                    }
+    /**
+     * @brief Mutex of the nodes, which counts acquisitions, contentions and the wait time.
+     */
+    class CVFSMutex
+    {
+        public:
+            CVFSMutex() : m_Contentions(0) {}
 
-                    /**
-                     * @return Returns the last modification time.
-                     */
-                    inline time_t Modified() const
-                    {
-                        std::lock_guard<std::mutex> lock(m_UpdateLock);
-                        return m_Modified;
-                    }
+            inline void lock()
+            {
+                auto &Counters = SVFSCounters::Instance();
+                Counters.LockAcquisitions.fetch_add(1, std::memory_order_relaxed);
 
+                if(m_Lock.try_lock())
+                    return;
 
-                    inline size_t Size() const
-                    {
-                        std::lock_guard<std::mutex> lock(m_UpdateLock);
-                        return m_Size;
-                    }
+                auto Start = std::chrono::steady_clock::now();
+                m_Lock.lock();
 
-                    /**
-                     * @return Returns a copy of this node.
-                     */
-                    VFSNode Copy() override
-                    {
-                        return VFSFile(new CVFSFile(*this));
-                    }
+                m_Contentions.fetch_add(1, std::memory_order_relaxed);
+                Counters.LockContentions.fetch_add(1, std::memory_order_relaxed);
+                Counters.LockWaitNs.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - Start).count(), std::memory_order_relaxed);
+            }
 
-                private:
-                    /**
-                     * Data chunk.
-                     */
-                    struct SChunk
-                    {
-                        public:
-                            SChunk()
-                            {
-                                Size = CHUNK_SIZE;
-                                Filled = 0;
-                                Data = new char[Size];
-                            }
+            inline bool try_lock()
+            {
+                return m_Lock.try_lock();
+            }
 
-                            int Size;
-                            int Filled;
-                            char *Data;
+            inline void unlock()
+            {
+                m_Lock.unlock();
+            }
 
-                            ~SChunk()
-                            {
-                                delete[] Data;
-                            }
-                    };
+            /**
+             * @return Returns the count of contended acquisitions of this mutex.
+             */
+            inline uint64_t Contentions() const
+            {
+                return m_Contentions.load(std::memory_order_relaxed);
+            }
 
-                    using Chunk = std::shared_ptr<SChunk>;
+        private:
+            std::mutex m_Lock;
+            std::atomic<uint32_t> m_Contentions;
+    };
 
-                    /**
-                     * @brief Reserves new space for data.
-                     * 
-                     * @param Count: Chunks to allocate.
-                     */
-                    void ReserveChunks(size_t Count)
-                    {
-                        m_Data.reserve(Count);
-                        for (size_t i = 0; i < Count; i++)
-                            m_Data.push_back(Chunk(new SChunk()));
-                    }
+    #define VFS_MEASURE(Op) CVFSStatsTimer VFSStatsTimer(Op)
+    #define VFS_COUNT(Counter, Value) SVFSCounters::Instance().Counter.fetch_add(Value, std::memory_order_relaxed)
+#else
+    using CVFSMutex = std::mutex;
 
-                    time_t m_Modified;
-                    size_t m_Size;
+    #define VFS_MEASURE(Op)
+    #define VFS_COUNT(Counter, Value)
+#endif
 
-                    std::vector<Chunk> m_Data;
-            };
+    /**
+     * @brief Mutex of the single threaded policy, all operations compile to nothing.
+     */
+    class CVFSNullMutex
+    {
+        public:
+            inline void lock() {}
+            inline bool try_lock() { return true; }
+            inline void unlock() {}
+            inline void lock_shared() {}
+            inline void unlock_shared() {}
 
-            class CVFSDir : public CVFSNode
+            inline uint64_t Contentions() const
             {
-                public:
-                    CVFSDir() : CVFSNode()
-                    {
-                        m_IsDir = true;
-                    }
+                return 0;
+            }
+    };
+
+    /**
+     * @brief Thread policy of CVFS, every node is guarded by its own mutex.
+     */
+    struct MultiThreaded
+    {
+        using Mutex = CVFSMutex;
+#if __cplusplus >= 201703L
+        using StructureMutex = std::shared_mutex;
+#else
+        using StructureMutex = std::shared_timed_mutex;
+#endif
+        static const bool THREAD_SAFE = true;
+    };
+
+    /**
+     * @brief Thread policy of CSingleThreadedVFS, for filesystems which are only used by one thread at a time.
+     * The node locks compile to nothing and the async api isn't available.
+     */
+    struct SingleThreaded
+    {
+        using Mutex = CVFSNullMutex;
+        using StructureMutex = CVFSNullMutex;
+        static const bool THREAD_SAFE = false;
+    };
+
+    /**
+     * @brief Worker pool with a bounded task queue. Used by the async api of CVFS.
+     */
+    class CVFSExecutor
+    {
+        public:
+            /**
+             * @param Threads: Count of worker threads, 0 uses the hardware concurrency.
+             * @param QueueSize: Maximum count of pending tasks. Submit blocks while the queue is full.
+             */
+            CVFSExecutor(size_t Threads = 0, size_t QueueSize = 1024) : m_QueueSize(QueueSize > 0 ? QueueSize : 1), m_Active(0), m_Running(true)
+            {
+                if(Threads == 0)
+                    Threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+
+                for (size_t i = 0; i < Threads; i++)
+                    m_Workers.emplace_back(&CVFSExecutor::Worker, this);
+            }
+
+            CVFSExecutor(const CVFSExecutor&) = delete;
+            CVFSExecutor &operator=(const CVFSExecutor&) = delete;
+
+            /**
+             * @brief Queues a task.
+             * 
+             * @param Task: Callable without arguments.
+             * 
+             * @return Returns a future which receives the result or the exception of the task.
+             * 
+             * @attention Blocks while the queue is full. Tasks which are submitted from a worker are executed inline instead.
+             */
+            template<class Func>
+            auto Submit(Func &&Task) -> std::future<decltype(Task())>
+            {
+                using Ret = decltype(Task());
+
+                auto Packaged = std::make_shared<std::packaged_task<Ret()>>(std::forward<Func>(Task));
+                auto Future = Packaged->get_future();
+                Enqueue([Packaged]() { (*Packaged)(); });
+
+                return Future;
+            }
+
+            /**
+             * @brief Waits until all queued tasks are finished.
+             */
+            void Drain()
+            {
+                std::unique_lock<std::mutex> lock(m_QueueLock);
+                m_Idle.wait(lock, [this]() { return m_Queue.empty() && m_Active == 0; });
+            }
+
+            /**
+             * @return Returns the count of worker threads.
+             */
+            size_t Threads() const
+            {
+                return m_Workers.size();
+            }
+
+            /**
+             * @return Returns true if the calling thread is a worker of this executor.
+             */
+            bool IsWorker() const
+            {
+                return Current() == this;
+            }
+
+            /**
+             * @return Returns the count of pending tasks.
+             */
+            size_t Pending() const
+            {
+                std::lock_guard<std::mutex> lock(m_QueueLock);
+                return m_Queue.size();
+            }
+
+            /**
+             * @brief Finishes all queued tasks and stops the workers.
+             */
+            ~CVFSExecutor()
+            {
+                {
+                    std::lock_guard<std::mutex> lock(m_QueueLock);
+                    m_Running = false;
+                }
+
+                m_NotEmpty.notify_all();
+                m_NotFull.notify_all();
+
+                for (auto &&e : m_Workers)
+                    e.join();
+            }
+
+        private:
+            /**
+             * Maximum count of tasks a worker takes per queue lock.
+             */
+            static const size_t MAX_BATCH = 16;
+
+            static CVFSExecutor *&Current()
+            {
+                static thread_local CVFSExecutor *Executor = nullptr;
+                return Executor;
+            }
+
+            void Enqueue(std::function<void()> Task)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(m_QueueLock);
 
-                    CVFSDir(const std::string &Name) : CVFSDir()
+                    //A worker waiting for its own queue would deadlock, so it runs the task by itself.
+                    if(Current() == this && m_Queue.size() >= m_QueueSize)
                     {
-                        m_Name = Name;
+                        lock.unlock();
+                        Task();
+                        return;
                     }
 
-                    CVFSDir(const CVFSDir &dir) : CVFSNode(dir)
+                    m_NotFull.wait(lock, [this]() { return m_Queue.size() < m_QueueSize || !m_Running; });
+                    m_Queue.push_back(std::move(Task));
+                }
+
+                m_NotEmpty.notify_one();
+            }
+
+            void Worker()
+            {
+                Current() = this;
+                std::vector<std::function<void()>> Batch;
+
+                while (true)
+                {
                     {
-                        m_Childs.reserve(dir.m_Childs.size());
-                        for (auto &&e : dir.m_Childs)
+                        std::unique_lock<std::mutex> lock(m_QueueLock);
+                        m_NotEmpty.wait(lock, [this]() { return !m_Queue.empty() || !m_Running; });
+
+                        if(m_Queue.empty())
+                            break;
+
+                        //Takes a fair share of the queue, so small tasks don't pay one lock each.
+                        size_t Count = std::max<size_t>(m_Queue.size() / m_Workers.size(), 1);
+                        Count = Count > MAX_BATCH ? MAX_BATCH : Count;
+                        for (size_t i = 0; i < Count; i++)
                         {
-                            m_Childs.push_back(e->Copy());
+                            Batch.push_back(std::move(m_Queue.front()));
+                            m_Queue.pop_front();
                         }
+
+                        m_Active += Count;
                     }
 
-                    /**
-                     * @brief Adds a new child to this directory.
-                     * 
-                     * @param Child: A file or dir to add.
-                     */
-                    void AppendChild(VFSNode Child)
+                    m_NotFull.notify_all();
+
+                    for (auto &&e : Batch)
+                        e();
+
                     {
-                        std::lock_guard<std::mutex> lock(m_UpdateLock);
-                        InternalAppendChild(Child);
+                        std::lock_guard<std::mutex> lock(m_QueueLock);
+                        m_Active -= Batch.size();
+                        if(m_Queue.empty() && m_Active == 0)
+                            m_Idle.notify_all();
                     }
 
-                    /**
-                     * @brief Searches for a node.
-                     * 
-                     * @param Name: Name of the node.
-                     * 
-                     * @return Returns the node of null if the node wasn't found.
-                     */
-                    VFSNode Search(const std::string &Name)
-                    {
-                        std::lock_guard<std::mutex> lock(m_UpdateLock);
-                        VFSNode Ret;
+                    Batch.clear();
+                }
+            }
 
-                        if(!m_Childs.empty())
-                        {
-                            size_t Pos = Search(Name, 0, m_Childs.size() - 1);
-                            if(m_Childs[Pos]->Name() == Name)
-                                Ret = m_Childs[Pos];
-                        }
+            std::vector<std::thread> m_Workers;
+            std::deque<std::function<void()>> m_Queue;
+            size_t m_QueueSize;
+            size_t m_Active;
+            bool m_Running;
 
-                        return Ret;
-                    }
+            mutable std::mutex m_QueueLock;
+            std::condition_variable m_NotEmpty;
+            std::condition_variable m_NotFull;
+            std::condition_variable m_Idle;
+    };
 
-                    /**
-                     * @brief Renames and reorders a child.
-                     * 
-                     * @param Name: Current name of the child.
-                     * @param NewName: New name of the child.
-                     */
-                    void RenameChild(const std::string &Name, const std::string &NewName)
+    class CVFSWatchHub;
+
+    /**
+     * @brief Registered watch.
+     */
+    struct SVFSWatch
+    {
+        SVFSWatch() : ID(0), Mask(VFSEvent::ALL), Active(true) {}
+
+        uint64_t ID;
+        VFSEvent Mask;
+        std::string Path;
+        VFSWatchCallback Callback;
+        std::weak_ptr<CVFSWatchHub> Hub;
+        std::atomic<bool> Active;
+    };
+
+    using VFSWatch = std::shared_ptr<SVFSWatch>;
+
+    /**
+     * @brief Watches of a node. Only allocated for watched nodes and childs of watched directories.
+     */
+    struct SVFSNodeWatches
+    {
+        SVFSNodeWatches() : WriteQueued(false) {}
+
+        std::vector<VFSWatch> Self;         //Watches of the node itself.
+        std::vector<VFSWatch> Parent;       //Watches of the parent directory.
+        std::atomic<bool> WriteQueued;      //Coalesces writes until the queued event is dispatched.
+    };
+
+    /**
+     * @brief Event queue of the watches of a filesystem.
+     * 
+     * Writers push events with a compare and swap onto a lock free stack, the consumer takes the whole stack at once.
+     */
+    class CVFSWatchHub
+    {
+        public:
+            CVFSWatchHub() : m_Head(nullptr), m_LastID(0) {}
+
+            CVFSWatchHub(const CVFSWatchHub&) = delete;
+            CVFSWatchHub &operator=(const CVFSWatchHub&) = delete;
+
+            /**
+             * @brief Registers a new watch.
+             */
+            void Register(const VFSWatch &Watch)
+            {
+                std::lock_guard<std::mutex> lock(m_WatchLock);
+                Watch->ID = ++m_LastID;
+                m_Watches[Watch->ID] = Watch;
+            }
+
+            /**
+             * @brief Deactivates a watch. Already queued events of the watch are dropped.
+             * 
+             * @return Returns false if the watch doesn't exists.
+             */
+            bool Unregister(uint64_t ID)
+            {
+                std::lock_guard<std::mutex> lock(m_WatchLock);
+                auto IT = m_Watches.find(ID);
+                if(IT == m_Watches.end())
+                    return false;
+
+                IT->second->Active = false;
+                m_Watches.erase(IT);
+                return true;
+            }
+
+            /**
+             * @brief Queues an event. Lock free.
+             * 
+             * @param Coalesced: Watches of a written file, which write flag is reset on dispatch.
+             */
+            void Push(const VFSWatch &Watch, VFSEvent Type, const std::string &Name, const std::string &NewName, const std::shared_ptr<SVFSNodeWatches> &Coalesced)
+            {
+                auto Node = new SEventNode{{Watch->ID, Type, Watch->Path, Name, NewName}, Watch, Coalesced, nullptr};
+                Node->Next = m_Head.load(std::memory_order_relaxed);
+                while (!m_Head.compare_exchange_weak(Node->Next, Node, std::memory_order_release, std::memory_order_relaxed));
+            }
+
+            /**
+             * @brief Calls the callbacks of all queued events in the order of the events.
+             * 
+             * @return Returns the count of delivered events.
+             */
+            size_t Dispatch()
+            {
+                //Reverses the stack into the order of the events.
+                SEventNode *List = m_Head.exchange(nullptr, std::memory_order_acquire);
+                SEventNode *Ordered = nullptr;
+                while (List)
+                {
+                    SEventNode *Next = List->Next;
+                    List->Next = Ordered;
+                    Ordered = List;
+                    List = Next;
+                }
+
+                size_t Ret = 0;
+                try
+                {
+                    while (Ordered)
                     {
-                        std::lock_guard<std::mutex> lock(m_UpdateLock);
-                        size_t Pos = Search(Name, 0, m_Childs.size() - 1);
-                        auto Child = m_Childs[Pos];
-                        if(Child->Name() == Name)
-                        {
-                            m_Childs.erase(m_Childs.begin() + Pos); //Removes the child temporary.
-                            Child->m_Name = NewName;
+                        std::unique_ptr<SEventNode> Node(Ordered);
+                        Ordered = Ordered->Next;
+
+                        //Later writes queue a new event.
+                        if(Node->Coalesced)
+                            Node->Coalesced->WriteQueued = false;
 
-                            InternalAppendChild(Child);
+                        if(Node->Watch->Active && Node->Watch->Callback)
+                        {
+                            Node->Watch->Callback(Node->Event);
+                            Ret++;
                         }
                     }
+                }
+                catch(...)
+                {
+                    Free(Ordered);
+                    throw;
+                }
 
-                    /**
-                     * @brief Removes a child.
-                     * 
-                     * @param Name: Name of the child.
-                     */
-                    void RemoveChild(const std::string &Name)
-                    {
-                        std::lock_guard<std::mutex> lock(m_UpdateLock);
-                        size_t Pos = Search(Name, 0, m_Childs.size() - 1);
-                        auto Child = m_Childs[Pos];
-                        if(Child->Name() == Name)
-                            m_Childs.erase(m_Childs.begin() + Pos); //Removes the child.
-                    }
+                return Ret;
+            }
 
-                    /**
-                     * @return Returns all childs of this dir.
-                     */
-                    std::vector<VFSNode> GetChilds()
-                    {
-                        std::lock_guard<std::mutex> lock(m_UpdateLock);
-                        m_Accessed = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-                        return m_Childs;
-                    }
+            ~CVFSWatchHub()
+            {
+                Free(m_Head.exchange(nullptr));
+            }
 
-                    /**
-                     * @return Returns a copy of this node.
-                     */
-                    VFSNode Copy() override
-                    {
-                        return VFSDir(new CVFSDir(*this));
-                    }
+        private:
+            struct SEventNode
+            {
+                SVFSEvent Event;
+                VFSWatch Watch;
+                std::shared_ptr<SVFSNodeWatches> Coalesced;
+                SEventNode *Next;
+            };
 
-                private:
-                    /**
-                     * @brief Binary search for faster searches.
-                     * 
-                     * @param Name: Name of the node to find.
-                     * @param Start: Start of the frame.
-                     * @param End: End of the frame.
-                     * 
-                     * @return Returns the position of the node.
-                     */
-                    size_t Search(const std::string &Name, size_t Start, size_t End)
-                    {
-                        if(End < Start || End == (size_t) -1)
-                            return 0;
-                        else if(End == Start)
-                            return End;
+            static void Free(SEventNode *List)
+            {
+                while (List)
+                {
+                    SEventNode *Next = List->Next;
+                    if(List->Coalesced)
+                        List->Coalesced->WriteQueued = false;
 
-                        size_t Middle = Start + (End - Start) / 2;
-                        std::string PosName = m_Childs[Middle]->Name();
-                        if(PosName == Name)
-                            return Middle;
-                        else if(Name > PosName)
-                            return Search(Name, Middle + 1, End);
-                        else if(Name < PosName)
-                            return Search(Name, Start, Middle - 1);
+                    delete List;
+                    List = Next;
+                }
+            }
 
-                        return Middle;                        
-                    }
+            std::atomic<SEventNode*> m_Head;
 
-                    /**
-                     * @brief Adds a new child to this directory.
-                     * 
-                     * @param Child: A file or dir to add.
-                     */
-                    void InternalAppendChild(VFSNode Child)
-                    {
-                        size_t Pos = 0;
+            std::map<uint64_t, VFSWatch> m_Watches;
+            uint64_t m_LastID;
+            std::mutex m_WatchLock;
+    };
+
+    template<class Policy> class CBasicVFSNameTable;
+
+    /**
+     * @brief Interned node name.
+     */
+    template<class Policy>
+    struct SBasicVFSName
+    {
+        SBasicVFSName(const std::string &Name, size_t NameHash, std::shared_ptr<CBasicVFSNameTable<Policy>> NameTable) : Str(Name), Hash(NameHash), Table(NameTable) {}
+        ~SBasicVFSName();
+
+        std::string Str;
+        size_t Hash;
+        std::shared_ptr<CBasicVFSNameTable<Policy>> Table;   //Table which removes the name, once no node uses it anymore.
+    };
+
+    /**
+     * @brief Stores each node name of a filesystem once, together with its hash.
+     * 
+     * The table is split into shards by the hash, so threads which create nodes with different names rarely share a lock.
+     * The shards of the single threaded policy aren't locked.
+     */
+    template<class Policy>
+    class CBasicVFSNameTable : public std::enable_shared_from_this<CBasicVFSNameTable<Policy>>
+    {
+        friend SBasicVFSName<Policy>;
+
+        //Unlike the node locks the shard locks don't collect statistics, so threads which intern names don't share a counter.
+        using Mutex = typename std::conditional<Policy::THREAD_SAFE, std::mutex, CVFSNullMutex>::type;
+        using SVFSName = SBasicVFSName<Policy>;
+        using VFSName = std::shared_ptr<const SVFSName>;
+
+        public:
+            /**
+             * @return Returns the FNV-1a hash of a name. The hash is the same for all tables.
+             */
+            static size_t Hash(const std::string &Name)
+            {
+                uint64_t Ret = 14695981039346656037ULL;
+                for (unsigned char c : Name)
+                {
+                    Ret ^= c;
+                    Ret *= 1099511628211ULL;
+                }
+
+                return (size_t)Ret;
+            }
+
+            /**
+             * @brief Compares an interned name with a string. Compares the hash before the string.
+             */
+            static inline bool Equal(const VFSName &Name, const std::string &Str, size_t StrHash)
+            {
+                return Name->Hash == StrHash && Name->Str == Str;
+            }
+
+            /**
+             * @return Returns the shared instance of a name. Creates it, if the name isn't used yet.
+             */
+            VFSName Intern(const std::string &Name)
+            {
+                size_t NameHash = Hash(Name);
+                auto &Shard = m_Shards[NameHash % SHARD_COUNT];
+
+                std::lock_guard<Mutex> lock(Shard.Lock);
+                auto IT = Shard.Names.find(SKey{Name.data(), Name.size(), NameHash});
+                if(IT != Shard.Names.end())
+                {
+                    auto Ret = IT->second.lock();
+                    if(Ret)
+                        return Ret;
+
+                    //The name is released right now, its destructor waits for the lock.
+                    Shard.Names.erase(IT);
+                }
+
+                auto Ret = std::make_shared<SVFSName>(Name, NameHash, this->shared_from_this());
+                Shard.Names.emplace(SKey{Ret->Str.data(), Ret->Str.size(), NameHash}, Ret);
+                return Ret;
+            }
+
+            /**
+             * @return Returns the count of distinct names.
+             */
+            size_t Size()
+            {
+                size_t Ret = 0;
+                for (auto &&e : m_Shards)
+                {
+                    std::lock_guard<Mutex> lock(e.Lock);
+                    Ret += e.Names.size();
+                }
+
+                return Ret;
+            }
+
+        private:
+            static const size_t SHARD_COUNT = 16;
+
+            /**
+             * @brief Points to the string of a name, which is alive as long as it is inside the table.
+             */
+            struct SKey
+            {
+                const char *Str;
+                size_t Size;
+                size_t Hash;
+
+                bool operator==(const SKey &Other) const
+                {
+                    return Hash == Other.Hash && Size == Other.Size && memcmp(Str, Other.Str, Size) == 0;
+                }
+            };
+
+            struct SKeyHash
+            {
+                size_t operator()(const SKey &Key) const
+                {
+                    return Key.Hash;
+                }
+            };
+
+            struct SShard
+            {
+                Mutex Lock;
+                std::unordered_map<SKey, std::weak_ptr<SVFSName>, SKeyHash> Names;
+            };
+
+            /**
+             * @brief Removes a name, which is destroyed.
+             */
+            void Release(const SVFSName *Name)
+            {
+                auto &Shard = m_Shards[Name->Hash % SHARD_COUNT];
+
+                std::lock_guard<Mutex> lock(Shard.Lock);
+                auto IT = Shard.Names.find(SKey{Name->Str.data(), Name->Str.size(), Name->Hash});
+
+                //The entry could already belong to a new instance of the name.
+                if(IT != Shard.Names.end() && IT->second.expired())
+                    Shard.Names.erase(IT);
+            }
+
+            SShard m_Shards[SHARD_COUNT];
+    };
+
+    template<class Policy>
+    inline SBasicVFSName<Policy>::~SBasicVFSName()
+    {
+        if(Table)
+            Table->Release(this);
+    }
+
+    /**
+     * @brief Base of all nodes.
+     */
+    template<class Policy>
+    class CBasicVFSNode
+    {
+        template<class> friend class CBasicVFS;
+
+        using Mutex = typename Policy::Mutex;
+        using VFSNode = std::shared_ptr<CBasicVFSNode>;
+        using CVFSNameTable = CBasicVFSNameTable<Policy>;
+        using VFSName = std::shared_ptr<const SBasicVFSName<Policy>>;
+
+        public:
+            CBasicVFSNode()
+            {
+                VFS_COUNT(LiveNodes, 1);
+                m_Created = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+                m_Accessed = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+            }
+
+            /**
+             * @param KeepTimes: Keeps the creation time of the node, otherwise the copy is created now.
+             */
+            CBasicVFSNode(const CBasicVFSNode &node, bool KeepTimes = false)
+            {
+                VFS_COUNT(LiveNodes, 1);
+                m_Name = node.Interned();
+                m_IsDir = node.m_IsDir;
+
+                m_Created = KeepTimes ? node.m_Created : std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+                m_Accessed = node.m_Accessed;
+            }
+
+            /**
+             * @return Gets the name of the node.
+             */
+            inline std::string Name() const
+            {
+                std::lock_guard<Mutex> lock(m_UpdateLock);
+                return m_Name ? m_Name->Str : std::string();
+            }
+
+            /**
+             * @return Gets the interned name of the node.
+             */
+            inline VFSName Interned() const
+            {
+                std::lock_guard<Mutex> lock(m_UpdateLock);
+                return m_Name;
+            }
+
+            /**
+             * @return Returns true if this node is a dir.
+             */
+            inline bool IsDir() const
+            {
+                std::lock_guard<Mutex> lock(m_UpdateLock);
+                return m_IsDir;
+            }
+
+            /**
+             * @return Returns the creation time of the node.
+             */
+            inline time_t Created() const
+            {
+                std::lock_guard<Mutex> lock(m_UpdateLock);
+                return m_Created;
+            }
+            
+            /**
+             * @return Returns the last access time of the node.
+             */
+            inline time_t Accessed() const
+            {
+                std::lock_guard<Mutex> lock(m_UpdateLock);
+                return m_Accessed;
+            }
+
+            /**
+             * @param KeepTimes: Keeps the creation times of the copied nodes.
+             * 
+             * @return Returns a copy of this node.
+             */
+            virtual VFSNode Copy(bool KeepTimes = false) = 0;
+
+            virtual ~CBasicVFSNode()
+            {
+                VFS_COUNT(LiveNodes, -1);
+            }
+
+        protected:
+            /**
+             * @brief Queues an event for the watches of this node. Must be called under the lock.
+             * 
+             * @param Type: Event type.
+             * @param Name: Name of a changed child or empty if the node itself changed.
+             * @param NewName: New name of a renamed node.
+             * @param Parent: Also notifies the watches of the parent directory.
+             */
+            inline void Notify(VFSEvent Type, const std::string &Name = "", const std::string &NewName = "", bool Parent = false)
+            {
+                if(!m_Watches)
+                    return;
+
+                std::shared_ptr<SVFSNodeWatches> Coalesced;
+                if(Type == VFSEvent::WRITE)
+                {
+                    if(m_Watches->WriteQueued.exchange(true))
+                        return;
+
+                    Coalesced = m_Watches;
+                }
+
+                size_t Pushed = NotifyAll(m_Watches->Self, Type, Name, NewName, Coalesced);
+                if(Parent)
+                    Pushed += NotifyAll(m_Watches->Parent, Type, m_Name->Str, NewName, Coalesced);
+
+                if(Coalesced && Pushed == 0)
+                    m_Watches->WriteQueued = false;
+            }
+
+            /**
+             * @brief Sets the watches of the parent directory. Must be called under the lock.
+             */
+            inline void SetParentWatches(const std::vector<VFSWatch> &Watches)
+            {
+                if(!m_Watches && Watches.empty())
+                    return;
+
+                if(!m_Watches)
+                    m_Watches = std::make_shared<SVFSNodeWatches>();
+
+                m_Watches->Parent = Watches;
+            }
+
+            /**
+             * @brief Adds a watch of this node. Must be called under the lock.
+             */
+            inline void AddWatch(const VFSWatch &Watch)
+            {
+                if(!m_Watches)
+                    m_Watches = std::make_shared<SVFSNodeWatches>();
+
+                //Drops removed watches.
+                auto &Self = m_Watches->Self;
+                Self.erase(std::remove_if(Self.begin(), Self.end(), [](const VFSWatch &w) { return !w->Active; }), Self.end());
+                Self.push_back(Watch);
+            }
+
+            static size_t NotifyAll(const std::vector<VFSWatch> &Watches, VFSEvent Type, const std::string &Name, const std::string &NewName, const std::shared_ptr<SVFSNodeWatches> &Coalesced)
+            {
+                size_t Ret = 0;
+                for (auto &&e : Watches)
+                {
+                    if(!e->Active || (e->Mask & Type) != Type)
+                        continue;
+
+                    auto Hub = e->Hub.lock();
+                    if(Hub)
+                    {
+                        Hub->Push(e, Type, Name, NewName, Coalesced);
+                        Ret++;
+                    }
+                }
+
+                return Ret;
+            }
+
+            std::shared_ptr<SVFSNodeWatches> m_Watches;
+
+            VFSName m_Name;     //Only changed under the lock of the node and its parent, so the parent can read it under its own lock.
+            bool m_IsDir;
+
+            time_t m_Created;
+            time_t m_Accessed;
+
+            mutable Mutex m_UpdateLock;
+    };
+
+    /**
+     * @brief Collects create, write, rename and delete operations, which are applied together by CVFS::Apply.
+     */
+    class CVFSBatch
+    {
+        template<class> friend class CBasicVFS;
+
+        public:
+            /**
+             * @brief Creates a directory.
+             */
+            void CreateDir(const std::string &Path)
+            {
+                m_Ops.push_back({BatchOp::CREATE_DIR, Path, ""});
+            }
+
+            /**
+             * @brief Creates or truncates a file and writes the data to it.
+             */
+            void CreateFile(const std::string &Path, std::string Data = "")
+            {
+                m_Ops.push_back({BatchOp::CREATE_FILE, Path, std::move(Data)});
+            }
+
+            /**
+             * @brief Appends data to a file. Creates the file, if it doesn't exists.
+             */
+            void Write(const std::string &Path, std::string Data)
+            {
+                m_Ops.push_back({BatchOp::WRITE, Path, std::move(Data)});
+            }
+
+            /**
+             * @brief Renames a node.
+             * 
+             * @param Path: Path to the node.
+             * @param Name: New Name of the node.
+             */
+            void Rename(const std::string &Path, const std::string &Name)
+            {
+                m_Ops.push_back({BatchOp::RENAME, Path, Name});
+            }
+
+            /**
+             * @brief Deletes a node.
+             */
+            void Delete(const std::string &Path)
+            {
+                m_Ops.push_back({BatchOp::DELETE, Path, ""});
+            }
+
+            /**
+             * @return Returns the count of collected operations.
+             */
+            inline size_t Size() const
+            {
+                return m_Ops.size();
+            }
+
+            /**
+             * @brief Removes all collected operations.
+             */
+            inline void Clear()
+            {
+                m_Ops.clear();
+            }
+
+        private:
+            enum class BatchOp
+            {
+                CREATE_DIR,
+                CREATE_FILE,
+                WRITE,
+                RENAME,
+                DELETE
+            };
+
+            struct SBatchOp
+            {
+                BatchOp Op;
+                std::string Path;
+                std::string Arg;    //Data to write or the new name.
+            };
+
+            std::vector<SBatchOp> m_Ops;
+    };
+
+    template<class Policy>
+    class CBasicVFS
+    {
+        friend class CBasicVFSFileStream<Policy>;
+        friend class CBasicVFSListCursor<Policy>;
+        friend class CSharedVFS;
+
+        public:
+            using Mutex = typename Policy::Mutex;
+            using StructureMutex = typename Policy::StructureMutex;
+            using CVFSNode = CBasicVFSNode<Policy>;
+            using VFSNode = std::shared_ptr<CVFSNode>;
+            using CVFSNameTable = CBasicVFSNameTable<Policy>;
+            using VFSName = std::shared_ptr<const SBasicVFSName<Policy>>;
+            using CVFSFileStream = CBasicVFSFileStream<Policy>;
+            using VFSFileStream = std::shared_ptr<CVFSFileStream>;
+            using CVFSListCursor = CBasicVFSListCursor<Policy>;
+            using VFSListCursor = std::shared_ptr<CVFSListCursor>;
+
+        public:
+            CBasicVFS(/* args */) : m_ReadOnly(false), m_LastHandle(0), m_Tasks(0)
+            {
+                m_Names = std::make_shared<CVFSNameTable>();
+
+                //Creates the root node.
+                m_Root = std::make_shared<CVFSDir>(m_Names->Intern("/"));
+            }
+
+            /**
+             * @brief Creates a readonly copy of the filesystem.
+             * 
+             * The directories are copied while creates, deletes, renames, moves and batches wait, so the snapshot contains
+             * the tree as it was at one point in time. The files are copied afterwards, each atomically, and share their data
+             * with this filesystem. Shared chunks are never modified, a writer copies a chunk before it writes into it.
+             * Reads, List and Serialize of the snapshot are not affected by later changes and writers never wait for snapshot readers.
+             * 
+             * @return Returns a readonly filesystem.
+             */
+            std::shared_ptr<CBasicVFS> Snapshot()
+            {
+                auto Ret = std::make_shared<CBasicVFS>();
+                Ret->m_Names = m_Names;
+
+                std::vector<SCapturedFile> Files;
+                {
+                    std::lock_guard<StructureMutex> Structure(m_StructureLock);
+                    Ret->m_Root = CaptureDirs(m_Root, Files);
+                }
+
+                //A file may be renamed meanwhile, the copy keeps the captured name, so the directory stays sorted.
+                ForEachParallel(Files.size(), [&Files](size_t i)
+                {
+                    auto &File = Files[i];
+                    auto Copy = File.Node->Copy(true);
+                    Copy->m_Name = std::move(File.Name);
+                    File.Dest->m_Childs[File.Pos] = std::move(Copy);
+                });
+
+                Ret->m_ReadOnly = true;
+                return Ret;
+            }
+
+            /**
+             * @brief Gets the operation statistics.
+             * 
+             * The counters are process wide and only collected, if the library is compiled with CVFS_ENABLE_STATS.
+             * The hot directories are the directories of this filesystem with the most contended locks.
+             * 
+             * @param HotDirs: Maximum count of hot directories to report.
+             */
+            SVFSStats Stats(size_t HotDirs = 10)
+            {
+                SVFSStats Ret;
+#ifdef CVFS_ENABLE_STATS
+                auto &Counters = SVFSCounters::Instance();
+
+                Ret.Enabled = true;
+                for (int i = 0; i < (int)VFSOp::COUNT; i++)
+                    Counters.Ops[i].Get(Ret.Ops[i]);
+
+                Ret.BytesRead = Counters.BytesRead;
+                Ret.BytesWritten = Counters.BytesWritten;
+                Ret.LockAcquisitions = Counters.LockAcquisitions;
+                Ret.LockContentions = Counters.LockContentions;
+                Ret.LockWaitNs = Counters.LockWaitNs;
+                Ret.LiveNodes = Counters.LiveNodes;
+                Ret.LiveChunks = Counters.LiveChunks;
+                Ret.ChunkBytes = Counters.ChunkBytes;
+
+                if(HotDirs > 0)
+                {
+                    CollectHotDirs(m_Root.get(), "", Ret.HotDirs);
+                    std::sort(Ret.HotDirs.begin(), Ret.HotDirs.end(), [](const std::pair<std::string, uint64_t> &a, const std::pair<std::string, uint64_t> &b) 
+                    { 
+                        return a.second > b.second; 
+                    });
+
+                    if(Ret.HotDirs.size() > HotDirs)
+                        Ret.HotDirs.resize(HotDirs);
+                }
+#else
+                (void)HotDirs;
+#endif
+                return Ret;
+            }
+
+            /**
+             * @brief Resets the operation histograms and byte and lock counters. Live totals are kept.
+             */
+            static void ResetStats()
+            {
+#ifdef CVFS_ENABLE_STATS
+                auto &Counters = SVFSCounters::Instance();
+                for (auto &&e : Counters.Ops)
+                    e.Reset();
+
+                Counters.BytesRead = 0;
+                Counters.BytesWritten = 0;
+                Counters.LockAcquisitions = 0;
+                Counters.LockContentions = 0;
+                Counters.LockWaitNs = 0;
+#endif
+            }
+
+            /**
+             * @brief Measures the memory of the tree. Each node is locked on its own while it is measured.
+             * 
+             * @param Wasters: Maximum count of files with the most unused bytes to report.
+             */
+            SVFSMemoryReport MemoryReport(size_t Wasters = 10)
+            {
+                SVFSMemoryReport Ret;
+                std::unordered_set<const void*> Seen;
+                WasterQueue Top;
+
+                MeasureDir(m_Root.get(), "", Ret, Seen, Top, Wasters);
+
+                while (!Top.empty())
+                {
+                    Ret.Wasters.push_back(Top.top().second);
+                    Top.pop();
+                }
+
+                std::reverse(Ret.Wasters.begin(), Ret.Wasters.end());
+                return Ret;
+            }
+
+            /**
+             * @brief Releases unused memory. Sparse extents are repacked into full chunks, unused tails of the last extent are released and
+             * files, which fit into the node, are moved back into it. Directories release unused capacity of their child vectors.
+             * 
+             * Each file is compacted on its own. Its data is copied without holding its lock and swapped in afterwards,
+             * so readers are only blocked for the swap. Files which are modified meanwhile, which chunks are shared with a copy or snapshot
+             * or which aren't verified yet (see VFSVerify::LAZY) are skipped. Compact can be repeated, compact files are skipped.
+             * 
+             * @param Budget: Maximum count of bytes to copy, 0 for no limit. The file which exceeds the budget is finished.
+             * 
+             * @return Returns the count of released bytes.
+             * 
+             * @throw Throws a CVFSException, if the system is out of memory.
+             */
+            size_t Compact(size_t Budget = 0)
+            {
+                try
+                {
+                    size_t Copied = 0;
+                    return CompactDir(m_Root.get(), Budget ? Budget : SIZE_MAX, Copied);
+                }
+                catch(const std::bad_alloc &e)
+                {
+                    throw CVFSException("Can't compact filesystem. Out of mem. bad_alloc: " + std::string(e.what()), VFSError::OUT_OF_MEM);
+                }
+            }
+
+            /**
+             * @return Returns true if the filesystem is a readonly snapshot.
+             */
+            inline bool IsReadOnly() const
+            {
+                return m_ReadOnly;
+            }
+
+            /**
+             * @brief Create a new directory.
+             * 
+             * @param Path: Path to the directory.
+             * @param Force: Creates all parent dirs, if they aren't exists.
+             * 
+             * @throw Throws a CVFSException, if the dir can't be created or the system is out of memory.
+             */
+            void CreateDir(const std::string &Path, bool Force = false)
+            {
+                CheckWritable();
+                auto Dirs = SplitPath(Path);
+                auto CurDir = m_Root;
+
+                for (size_t i = 0; i < Dirs.size(); i++)
+                {
+                    std::string Dir = Dirs[i];
+
+                    auto node = CurDir->Search(Dir);
+
+                    //Creates the directory either if Force is true or we are at the end of the path.
+                    if(!node && (Force || (i == Dirs.size() - 1)))
+                    {
+                        VFSDir tmp;
+                        try
+                        {
+                            tmp = std::make_shared<CVFSDir>(m_Names->Intern(Dir));
+                            std::shared_lock<StructureMutex> Structure(m_StructureLock);
+                            CurDir->AppendChild(tmp);
+                        }
+                        catch(const std::bad_alloc &e)
+                        {
+                            throw CVFSException("Can't create directory. Out of mem. bad_alloc: " + std::string(e.what()), VFSError::OUT_OF_MEM);
+                        }
+                        
+                        CurDir = tmp;
+                    }
+                    else if(!node || !node->IsDir())
+                        throw CVFSException("Can't create directory", VFSError::CANT_CREATE_DIR);
+                    else
+                        CurDir = std::static_pointer_cast<CVFSDir>(node);
+                }               
+            }
+
+            /**
+             * @return Gets the information of a given node. Returns null if the node wasn't found.
+             */
+            VFSNode GetNodeInfo(const std::string &Path)
+            {
+                VFS_MEASURE(VFSOp::LOOKUP);
+                if(Path == "/")
+                    return m_Root;
+
+                auto Dirs = SplitPath(Path);
+                if(Dirs.empty())
+                    return nullptr;
+
+                return Resolve(m_Root, Dirs);
+            }
+
+            /**
+             * @return Checks if a given node already exists. Return true if the node exists.
+             */
+            bool NodeExists(const std::string &Path)
+            {
+                return GetNodeInfo(Path) != nullptr; 
+            }
+
+            /**
+             * @return Gets a list of the content of a directory.
+             * 
+            * @throw Throws a CVFSException, if the given node is a file.
+             */
+            std::vector<VFSNode> List(const std::string &Path)
+            {
+                auto node = GetNodeInfo(Path);
+                return List(node);
+            }
+
+            /**
+             * @return Gets a list of the content of a directory.
+             * 
+             * @throw Throws a CVFSException, if the given node is a file.
+             */
+            std::vector<VFSNode> List(VFSNode node)
+            {
+                std::vector<VFSNode> Ret;
+                if(node && node->IsDir())
+                {
+                    auto Dir = std::static_pointer_cast<CVFSDir>(node);
+                    Ret = Dir->GetChilds();
+                }
+                else if(node && !node->IsDir())
+                    throw CVFSException("Given node is not a directory", VFSError::NODE_IS_FILE);
+
+                return Ret;
+            }
+
+            /**
+             * @brief Gets one page of the content of a directory, sorted by name.
+             *
+             * @param Path: Path to the directory.
+             * @param StartAfter: Only nodes which names are greater are returned, e.g. the name of the last node of the previous page. Empty for the first page.
+             * @param Limit: Maximum count of nodes.
+             *
+             * @throw Throws a CVFSException, if the given node is a file.
+             */
+            std::vector<VFSNode> ListRange(const std::string &Path, const std::string &StartAfter, size_t Limit)
+            {
+                std::vector<VFSNode> Ret;
+                auto Cursor = ListCursor(Path, "", StartAfter);
+                if(Cursor)
+                    Ret = Cursor->Next(Limit);
+
+                return Ret;
+            }
+
+            /**
+             * @brief Gets all nodes of a directory which names start with a prefix, sorted by name.
+             *
+             * @throw Throws a CVFSException, if the given node is a file.
+             */
+            std::vector<VFSNode> ListPrefix(const std::string &Path, const std::string &Prefix)
+            {
+                std::vector<VFSNode> Ret;
+                auto Cursor = ListCursor(Path, Prefix);
+                if(Cursor)
+                    Ret = Cursor->Next(std::numeric_limits<size_t>::max());
+
+                return Ret;
+            }
+
+            /**
+             * @brief Creates a cursor, which iterates lazily over the content of a directory sorted by name.
+             *
+             * @param Path: Path to the directory.
+             * @param Prefix: Only nodes which names start with the prefix are returned.
+             * @param StartAfter: Only nodes which names are greater are returned.
+             *
+             * @return Returns the cursor or null if the directory doesn't exists.
+             *
+             * @throw Throws a CVFSException, if the given node is a file.
+             */
+            VFSListCursor ListCursor(const std::string &Path, const std::string &Prefix = "", const std::string &StartAfter = "")
+            {
+                auto node = GetNodeInfo(Path);
+                if(!node)
+                    return nullptr;
+
+                if(!node->IsDir())
+                    throw CVFSException("Given node is not a directory", VFSError::NODE_IS_FILE);
+
+                return VFSListCursor(new CVFSListCursor(std::static_pointer_cast<CVFSDir>(node), Prefix, StartAfter));
+            }
+
+            /**
+             * @brief Creates or opens a file.
+             * 
+             * @param Path: Path to the file.
+             * @param mode: Access mode.
+             * @param Reserve: Expected size of the file. Storage up to this size is allocated now, see CVFSFileStream::Reserve.
+             * 
+             * @throw Throws a CVFSException, if the given node is a directory or if the file can't opened for readonly.
+             */
+            VFSFileStream Open(const std::string &Path, FileMode mode, size_t Reserve = 0);
+
+            /**
+             * @brief Reads a whole file on the executor.
+             * 
+             * @param Path: Path to the file.
+             * 
+             * @return Returns a future which receives the file content or the CVFSException.
+             */
+            std::future<std::string> AsyncRead(const std::string &Path);
+
+            /**
+             * @brief Writes data to a file on the executor.
+             * 
+             * @param Path: Path to the file.
+             * @param Data: Data to write.
+             * @param mode: Access mode. Pending appends to the same file are written with one lock acquisition.
+             * 
+             * @return Returns a future which receives the written size or the CVFSException.
+             */
+            std::future<size_t> AsyncWrite(const std::string &Path, std::string Data, FileMode mode = FileMode::WRITE);
+
+            /**
+             * @brief Serializes the filesystem on the executor.
+             * 
+             * @return Returns a future which receives the stream or the CVFSException.
+             */
+            std::future<std::vector<char>> AsyncSerialize()
+            {
+                static_assert(Policy::THREAD_SAFE, "The async api needs a thread safe policy.");
+                return SubmitTask([this]() { return Serialize(); });
+            }
+
+            /**
+             * @brief Copies a node on the executor.
+             * 
+             * @return Returns a future which receives the CVFSException on error.
+             */
+            std::future<void> AsyncCopy(const std::string &From, const std::string &To)
+            {
+                static_assert(Policy::THREAD_SAFE, "The async api needs a thread safe policy.");
+                return SubmitTask([this, From, To]() { Copy(From, To); });
+            }
+
+            /**
+             * @brief Compacts the filesystem on the executor, see Compact.
+             * 
+             * @return Returns a future which receives the count of released bytes or the CVFSException.
+             */
+            std::future<size_t> AsyncCompact(size_t Budget = 0)
+            {
+                static_assert(Policy::THREAD_SAFE, "The async api needs a thread safe policy.");
+                return SubmitTask([this, Budget]() { return Compact(Budget); });
+            }
+
+            /**
+             * @brief Replaces the executor of the async api, e.g. to share one pool between filesystems.
+             * 
+             * @attention Queued tasks of the old executor are finished before it is released.
+             */
+            void SetExecutor(std::shared_ptr<CVFSExecutor> Executor)
+            {
+                std::lock_guard<std::mutex> lock(m_ExecutorLock);
+                m_Executor = Executor;
+            }
+
+            /**
+             * @return Returns the executor of the async api. Creates a default one, if none is set.
+             */
+            std::shared_ptr<CVFSExecutor> GetExecutor()
+            {
+                std::lock_guard<std::mutex> lock(m_ExecutorLock);
+                if(!m_Executor)
+                    m_Executor = std::make_shared<CVFSExecutor>();
+
+                return m_Executor;
+            }
+
+            /**
+             * @brief Waits until the memory of deleted nodes and overwritten files is released.
+             * Memory is released on the executor, so this also waits for all other tasks of the executor.
+             * Returns right away on a worker of the executor, which can't wait for itself.
+             */
+            void Drain()
+            {
+                std::shared_ptr<CVFSExecutor> Executor;
+                {
+                    std::lock_guard<std::mutex> lock(m_ExecutorLock);
+                    Executor = m_Executor;
+                }
+
+                if(Executor && !Executor->IsWorker())
+                    Executor->Drain();
+            }
+
+            /**
+             * @brief Watches a node. Events of a directory include the events of its direct childs.
+             * 
+             * @param Path: Path to the node.
+             * @param Mask: Events to receive.
+             * @param Callback: Called by DispatchEvents for each event.
+             * 
+             * @return Returns the id of the watch.
+             * 
+             * @throw Throws a CVFSException, if the node doesn't exists.
+             */
+            uint64_t Watch(const std::string &Path, VFSEvent Mask, VFSWatchCallback Callback)
+            {
+                auto node = GetNodeInfo(Path);
+                if(!node)
+                    throw CVFSException("Can't watch node. Node doesn't exists.", VFSError::NODE_DOESNT_EXISTS);
+
+                auto Hub = GetWatchHub();
+                auto Watch = std::make_shared<SVFSWatch>();
+                Watch->Mask = Mask;
+                Watch->Path = Path;
+                Watch->Callback = Callback;
+                Watch->Hub = Hub;
+                Hub->Register(Watch);
+
+                if(node->IsDir())
+                    std::static_pointer_cast<CVFSDir>(node)->Watch(Watch);
+                else
+                {
+                    std::lock_guard<Mutex> lock(node->m_UpdateLock);
+                    node->AddWatch(Watch);
+                }
+
+                return Watch->ID;
+            }
+
+            /**
+             * @brief Removes a watch. Queued events of the watch are dropped.
+             * 
+             * @return Returns false if the watch doesn't exists.
+             */
+            bool Unwatch(uint64_t ID)
+            {
+                return GetWatchHub()->Unregister(ID);
+            }
+
+            /**
+             * @brief Calls the callbacks of all queued events on the calling thread.
+             * 
+             * @return Returns the count of delivered events.
+             */
+            size_t DispatchEvents()
+            {
+                return GetWatchHub()->Dispatch();
+            }
+
+            /**
+             * @return Returns the file size.
+             */
+            size_t FileSize(VFSNode node)
+            {
+                if(!node->IsDir())
+                {
+                    auto file = std::static_pointer_cast<CVFSFile>(node);
+                    return file->Size();
+                }
+                else if(node && !node->IsDir())
+                    throw CVFSException("Given node is not a file.", VFSError::NODE_IS_DIR);
+
+                return 0;
+            }
+
+            /**
+             * @brief Renames a node.
+             * 
+             * @param Path: Path to the node.
+             * @param Name: New Name of the node.
+             * 
+             * @throw Throws a CVFSException, if a node with the given name already exists or the node doesn't exists.
+             */
+            void Rename(const std::string &Path, const std::string &Name)
+            {
+                CheckWritable();
+                RenameNode(m_Root, Path, Name);
+            }
+
+            /**
+             * @brief Moves a node atomically, also between directories.
+             * 
+             * Moves are serialized by one lock of the filesystem, so the ancestors of both parents can't change meanwhile.
+             * Both parents are locked together, ancestors before their descendants.
+             * 
+             * @param From: The node to move.
+             * @param To: Desitination directory of the node.
+             * @param Name: New name of the node. Empty to keep the name.
+             * 
+             * @throw Throws a CVFSException on error, e.g. if the destination already has a node with the name or is inside the moved node.
+             */
+            void Move(const std::string &From, const std::string &To, const std::string &Name = "")
+            {
+                CheckWritable();
+                std::lock_guard<Mutex> lock(m_MoveLock);
+
+                std::string SrcName;
+                std::vector<CVFSNode*> SrcTrail, DestTrail;
+                auto SrcParent = ResolveParent(m_Root, From, SrcName, &SrcTrail);
+                auto node = SrcParent ? SrcParent->Search(SrcName) : nullptr;
+                if(!node)
+                    throw CVFSException("Can't move node. Source node doesn't exists.", VFSError::NODE_DOESNT_EXISTS);
+
+                auto DestNode = Resolve(m_Root, SplitPath(To), &DestTrail);
+                if(!DestNode)
+                    throw CVFSException("Can't move node. Destination node doesn't exists.", VFSError::NODE_DOESNT_EXISTS);
+                else if(!DestNode->IsDir())
+                    throw CVFSException("Can't move node. Destination node is a file.", VFSError::NODE_IS_FILE);
+
+                //The trails are the ancestors of the resolved nodes. Only moves change them, so they stay valid while the lock is held.
+                if(DestNode == node || std::find(DestTrail.begin(), DestTrail.end(), node.get()) != DestTrail.end())
+                    throw CVFSException("Can't move node. Destination is inside the node.", VFSError::INVALID_DESTINATION);
+
+                auto Dest = std::static_pointer_cast<CVFSDir>(DestNode);
+                std::shared_lock<StructureMutex> Structure(m_StructureLock);
+                if(Dest == SrcParent)
+                {
+                    if(!Name.empty() && Name != SrcName)
+                        SrcParent->RenameChild(SrcName, m_Names->Intern(Name), node.get());
+
+                    return;
+                }
+
+                bool SrcFirst = std::find(SrcTrail.begin(), SrcTrail.end(), DestNode.get()) == SrcTrail.end();
+                CVFSDir::MoveChild(*SrcParent, *Dest, SrcName, *node, m_Names->Intern(Name.empty() ? SrcName : Name), SrcFirst);
+            }
+
+            /**
+             * @brief Deletes a node.
+             * 
+             * @throw Throws a CVFSException on error.
+             */
+            void Delete(const std::string &Path)
+            {
+                CheckWritable();
+                RemoveNode(m_Root, Path);
+            }
+
+            /**
+             * @brief Copies a node.
+             * 
+             * @param From: The node to copy.
+             * @param To: Desitination of the copy.
+             * 
+             * @throw Throws a CVFSException on error.
+             */
+            void Copy(const std::string &From, const std::string &To)
+            {
+                CheckWritable();
+                auto node = GetNodeInfo(From);
+                if(!node)
+                    throw CVFSException("Can't copy node. Source node doesn't exists.", VFSError::NODE_DOESNT_EXISTS);
+
+                auto Names = SplitPath(To);
+                if(Names.empty())
+                    throw CVFSException("Can't copy node. Destination node already exists.", VFSError::NODE_ALREADY_EXISTS);
+
+                std::string Name = std::move(Names.back());
+                Names.pop_back();
+
+                auto DestNode = Resolve(m_Root, Names);
+                if(!DestNode)
+                    throw CVFSException("Can't copy node. Destination node parent doesn't exists.", VFSError::NODE_DOESNT_EXISTS);
+                else if(!DestNode->IsDir())
+                    throw CVFSException("Can't copy node. Destination node parent is a file.", VFSError::NODE_IS_FILE);
+
+                auto DestParent = std::static_pointer_cast<CVFSDir>(DestNode);
+                if(DestParent->Search(Name))
+                    throw CVFSException("Can't copy node. Destination node already exists.", VFSError::NODE_ALREADY_EXISTS);
+
+                auto copy = CopyNode(node);
+                copy->m_Name = m_Names->Intern(Name);
+
+                //Another thread may have created the destination while copying.
+                bool Added;
+                {
+                    std::shared_lock<StructureMutex> Structure(m_StructureLock);
+                    Added = DestParent->TryAppendChild(copy);
+                }
+
+                if(!Added)
+                {
+                    Reclaim(std::move(copy));
+                    throw CVFSException("Can't copy node. Destination node already exists.", VFSError::NODE_ALREADY_EXISTS);
+                }
+            }
+
+            /**
+             * @brief Opens a handle to a node. The handle refers to the node itself, so it stays valid if the node is renamed or moved.
+             * A handle to a deleted node can still be used, but the node isn't part of the filesystem anymore.
+             * 
+             * @param Path: Path to the node.
+             * 
+             * @return Returns the id of the handle, which is used by the *At operations.
+             * 
+             * @throw Throws a CVFSException, if the node doesn't exists.
+             */
+            uint64_t OpenHandle(const std::string &Path)
+            {
+                auto node = GetNodeInfo(Path);
+                if(!node)
+                    throw CVFSException("Can't open handle. Node doesn't exists.", VFSError::NODE_DOESNT_EXISTS);
+
+                return AddHandle(node);
+            }
+
+            /**
+             * @brief Opens a handle to a node relative to a directory handle.
+             * 
+             * @param Dir: Handle of a directory.
+             * @param Path: Relative path to the node.
+             * 
+             * @throw Throws a CVFSException, if the node doesn't exists or the handle is invalid.
+             */
+            uint64_t OpenHandle(uint64_t Dir, const std::string &Path)
+            {
+                auto node = StatAt(Dir, Path);
+                if(!node)
+                    throw CVFSException("Can't open handle. Node doesn't exists.", VFSError::NODE_DOESNT_EXISTS);
+
+                return AddHandle(node);
+            }
+
+            /**
+             * @brief Closes a handle.
+             * 
+             * @return Returns false if the handle doesn't exists.
+             */
+            bool CloseHandle(uint64_t Handle)
+            {
+                VFSNode node;   //Released after the lock.
+                std::lock_guard<Mutex> lock(m_HandleLock);
+                auto IT = m_Handles.find(Handle);
+                if(IT == m_Handles.end())
+                    return false;
+
+                node = std::move(IT->second);
+                m_Handles.erase(IT);
+                return true;
+            }
+
+            /**
+             * @brief Gets a node relative to a directory handle, without walking from the root.
+             * 
+             * @param Dir: Handle of a directory.
+             * @param Path: Relative path to the node. An empty path returns the directory itself.
+             * 
+             * @return Returns the node or null if the node wasn't found.
+             * 
+             * @throw Throws a CVFSException, if the handle is invalid or not a directory.
+             */
+            VFSNode StatAt(uint64_t Dir, const std::string &Path)
+            {
+                VFS_MEASURE(VFSOp::LOOKUP);
+                return Resolve(GetHandleDir(Dir), SplitPath(Path));
+            }
+
+            /**
+             * @return Gets a list of the content of a directory handle.
+             * 
+             * @throw Throws a CVFSException, if the handle is invalid or not a directory.
+             */
+            std::vector<VFSNode> ListAt(uint64_t Dir)
+            {
+                return GetHandleDir(Dir)->GetChilds();
+            }
+
+            /**
+             * @brief Creates or opens a file relative to a directory handle.
+             * 
+             * @param Dir: Handle of a directory.
+             * @param Path: Relative path to the file.
+             * @param mode: Access mode.
+             * @param Reserve: Expected size of the file, see Open.
+             * 
+             * @return Returns the stream or null if the parent directory doesn't exists.
+             * 
+             * @throw Throws a CVFSException, if the handle is invalid, the given node is a directory or if the file can't opened for readonly.
+             */
+            VFSFileStream OpenAt(uint64_t Dir, const std::string &Path, FileMode mode, size_t Reserve = 0)
+            {
+                VFS_MEASURE(VFSOp::OPEN);
+                if((mode & FileMode::WRITE) == FileMode::WRITE)
+                    CheckWritable();
+
+                std::string Name;
+                auto Parent = ResolveParent(GetHandleDir(Dir), Path, Name);
+                auto node = Parent ? Parent->Search(Name) : nullptr;
+
+                VFSFile file;
+                if(node && !node->IsDir())
+                    file = std::static_pointer_cast<CVFSFile>(node);
+                else if(node)
+                    throw CVFSException("Can't open file. A directory with the given name already exists.", VFSError::CANT_CREATE_FILE);
+                else if((mode & FileMode::WRITE) == FileMode::WRITE)
+                {
+                    if(!Parent)
+                        return nullptr;
+
+                    file = std::make_shared<CVFSFile>(m_Names->Intern(Name));
+                    std::shared_lock<StructureMutex> Structure(m_StructureLock);
+                    Parent->AppendChild(file);
+                }
+                else
+                    throw CVFSException("Can't open file. File doesn't exists.", VFSError::CANT_OPEN_FILE);
+
+                return OpenStream(file, mode, Reserve);
+            }
+
+            /**
+             * @brief Creates a directory relative to a directory handle.
+             * 
+             * @param Dir: Handle of a directory.
+             * @param Path: Relative path of the new directory. The parent directory must exist.
+             * 
+             * @throw Throws a CVFSException, if the handle is invalid, the dir can't be created or the system is out of memory.
+             */
+            void CreateDirAt(uint64_t Dir, const std::string &Path)
+            {
+                CheckWritable();
+                std::string Name;
+                auto Parent = ResolveParent(GetHandleDir(Dir), Path, Name);
+                bool Created = false;
+                if(Parent)
+                {
+                    try
+                    {
+                        auto Dir = std::make_shared<CVFSDir>(m_Names->Intern(Name));
+                        std::shared_lock<StructureMutex> Structure(m_StructureLock);
+                        Created = Parent->TryAppendChild(Dir);
+                    }
+                    catch(const std::bad_alloc &e)
+                    {
+                        throw CVFSException("Can't create directory. Out of mem. bad_alloc: " + std::string(e.what()), VFSError::OUT_OF_MEM);
+                    }
+                }
+
+                if(!Created)
+                    throw CVFSException("Can't create directory", VFSError::CANT_CREATE_DIR);
+            }
+
+            /**
+             * @brief Renames a node relative to a directory handle.
+             * 
+             * @param Dir: Handle of a directory.
+             * @param Path: Relative path to the node.
+             * @param Name: New Name of the node.
+             * 
+             * @throw Throws a CVFSException, if the handle is invalid, a node with the given name already exists or the node doesn't exists.
+             */
+            void RenameAt(uint64_t Dir, const std::string &Path, const std::string &Name)
+            {
+                CheckWritable();
+                RenameNode(GetHandleDir(Dir), Path, Name);
+            }
+
+            /**
+             * @brief Deletes a node relative to a directory handle.
+             * 
+             * @throw Throws a CVFSException, if the handle is invalid or the node doesn't exists.
+             */
+            void DeleteAt(uint64_t Dir, const std::string &Path)
+            {
+                CheckWritable();
+                RemoveNode(GetHandleDir(Dir), Path);
+            }
+
+            /**
+             * @brief Applies all operations of a batch.
+             * 
+             * The operations are grouped by their parent directory. Each parent is resolved once
+             * and all operations of a group are applied under one lock of the parent, new childs are merged
+             * in one pass. Groups are applied in path order, so a directory created by the batch can be used
+             * as parent by later operations. Inside a group the operations are applied in the order they were added.
+             * 
+             * The batch is checked before anything is changed: each parent must exist or be created by the batch,
+             * and a directory which is deleted or renamed can't be the parent of other operations of the batch,
+             * because the path order would apply them in another order than they were added.
+             * 
+             * @throw Throws a CVFSException on error. The structure and the file data of the failing directory stay unchanged,
+             * groups which are applied before stay applied.
+             */
+            void Apply(const CVFSBatch &Batch)
+            {
+                CheckWritable();
+                std::map<std::string, std::vector<const CVFSBatch::SBatchOp*>> Groups;
+                std::unordered_set<std::string> Created;
+                std::vector<std::string> Moved;
+                for (auto &&e : Batch.m_Ops)
+                {
+                    auto Dirs = SplitPath(ExtractPath(e.Path));
+
+                    std::string Parent;
+                    for (auto &&d : Dirs)
+                        Parent += "/" + d;
+
+                    std::string Path = Parent + "/" + ExtractName(e.Path);
+                    Groups[Parent.empty() ? "/" : Parent].push_back(&e);
+                    if(e.Op == CVFSBatch::BatchOp::CREATE_DIR)
+                        Created.insert(Path);
+                    else if(e.Op == CVFSBatch::BatchOp::DELETE || e.Op == CVFSBatch::BatchOp::RENAME)
+                        Moved.push_back(Path);
+                }
+
+                for (auto &&e : Moved)
+                {
+                    auto IT = Groups.lower_bound(e + "/");
+                    if(Groups.count(e) || (IT != Groups.end() && IT->first.compare(0, e.size() + 1, e + "/") == 0))
+                        throw CVFSException("Can't apply batch. A deleted or renamed node is the parent of other operations: " + e, VFSError::INVALID_DESTINATION);
+                }
+
+                //Parents which are created by the batch are resolved once the group of their parent is applied.
+                std::vector<VFSDir> Parents;
+                for (auto &&e : Groups)
+                {
+                    if(Created.count(e.first))
+                    {
+                        Parents.push_back(nullptr);
+                        continue;
+                    }
+
+                    auto node = GetNodeInfo(e.first);
+                    if(!node)
+                        throw CVFSException("Can't apply batch. Parent directory doesn't exists.", VFSError::NODE_DOESNT_EXISTS);
+                    else if(!node->IsDir())
+                        throw CVFSException("Can't apply batch. Parent node is a file.", VFSError::NODE_IS_FILE);
+
+                    Parents.push_back(std::static_pointer_cast<CVFSDir>(node));
+                }
+
+                std::vector<std::shared_ptr<void>> Garbage;
+                size_t Index = 0;
+
+                //The batch appears as a whole in snapshots.
+                std::shared_lock<StructureMutex> Structure(m_StructureLock);
+                for (auto &&e : Groups)
+                {
+                    auto Dir = Parents[Index++];
+                    if(!Dir)
+                    {
+                        auto node = GetNodeInfo(e.first);
+                        if(!node || !node->IsDir())
+                            throw CVFSException("Can't apply batch. Parent directory doesn't exists.", VFSError::NODE_DOESNT_EXISTS);
+
+                        Dir = std::static_pointer_cast<CVFSDir>(node);
+                    }
+
+                    Dir->Apply(e.second, *m_Names, Garbage);
+                }
+
+                Structure.unlock();
+
+                if(!Garbage.empty())
+                    Reclaim(std::make_shared<std::vector<std::shared_ptr<void>>>(std::move(Garbage)));
+            }
+
+#ifdef CVFS_HAS_FILESYSTEM
+            /**
+             * @brief Copies a directory tree of the host into the filesystem.
+             * 
+             * The structure is created first, afterwards the files are read in parallel on the executor.
+             * Each file is read with large reads straight into extents of up to MAX_EXTENT_SIZE.
+             * The modification times of the files are carried over, directories get the modification time of the host as creation time,
+             * which is the time ExportTree and ExportTar write for them.
+             * 
+             * @param HostPath: Directory on the host.
+             * @param Path: Destination directory, it is created if it doesn't exists. Existing files are overwritten.
+             * 
+             * @return Returns the count of imported files.
+             * 
+             * @throw Throws a CVFSException on error.
+             */
+            size_t ImportTree(const std::string &HostPath, const std::string &Path)
+            {
+                namespace fs = std::filesystem;
+                CheckWritable();
+
+                std::error_code Error;
+                fs::path Root(HostPath);
+                if(!fs::is_directory(Root, Error))
+                    throw CVFSException("Can't import tree. Host path is not a directory: " + HostPath, VFSError::HOST_IO_FAILED);
+
+                std::string Dest = Path == "/" ? "" : Path;
+                std::vector<std::pair<std::string, fs::path>> Dirs;
+                if(!Dest.empty())
+                {
+                    CreateDir(Dest, true);
+                    Dirs.push_back({Dest, Root});
+                }
+
+                //Creates the structure and the empty files.
+                std::vector<std::pair<VFSFile, fs::path>> Files;
+                for (fs::recursive_directory_iterator IT(Root, Error), End; !Error && IT != End; IT.increment(Error))
+                {
+                    std::string NodePath = Dest + "/" + IT->path().lexically_relative(Root).generic_string();
+                    if(IT->is_directory(Error))
+                    {
+                        if(!NodeExists(NodePath))
+                            CreateDir(NodePath);
+
+                        Dirs.push_back({NodePath, IT->path()});
+                    }
+                    else if(IT->is_regular_file(Error))
+                        Files.push_back({OpenFile(NodePath, FileMode::WRITE), IT->path()});
+                }
+
+                if(Error)
+                    throw CVFSException("Can't import tree. " + Error.message(), VFSError::HOST_IO_FAILED);
+
+                ForEachParallel(Files.size(), [&](size_t i)
+                {
+                    auto &Host = Files[i].second;
+                    std::FILE *File = std::fopen(Host.string().c_str(), "rb");
+                    if(!File)
+                        throw CVFSException("Can't import tree. Can't open host file: " + Host.string(), VFSError::HOST_IO_FAILED);
+
+                    std::error_code FileError;
+                    size_t Size = (size_t)fs::file_size(Host, FileError);
+                    time_t Modified = ToTime(fs::last_write_time(Host, FileError));
+                    bool Ok = !FileError && Files[i].first->Load(File, Size, Modified);
+                    std::fclose(File);
+
+                    if(!Ok)
+                        throw CVFSException("Can't import tree. Can't read host file: " + Host.string(), VFSError::HOST_IO_FAILED);
+                });
+
+                //Deepest directories first, like ExportTree.
+                for (size_t i = Dirs.size(); i-- > 0;)
+                {
+                    auto Time = fs::last_write_time(Dirs[i].second, Error);
+                    if(Error)
+                        throw CVFSException("Can't import tree. Can't read host directory: " + Dirs[i].second.string(), VFSError::HOST_IO_FAILED);
+
+                    auto Dir = GetNodeInfo(Dirs[i].first);
+                    if(Dir && Dir->IsDir())
+                    {
+                        std::lock_guard<Mutex> lock(Dir->m_UpdateLock);
+                        Dir->m_Created = ToTime(Time);
+                    }
+                }
+
+                return Files.size();
+            }
+
+            /**
+             * @brief Copies a directory tree of the filesystem to the host.
+             * 
+             * The directories are created first, afterwards the files are written in parallel on the executor.
+             * Each file is captured once and written with one write per extent. The modification times are carried over,
+             * directories get their creation time as modification time, like in ExportTar. It is set after the files are written.
+             * 
+             * @param Path: Directory inside the filesystem.
+             * @param HostPath: Destination directory on the host, it is created if it doesn't exists. Existing files are overwritten.
+             * 
+             * @return Returns the count of exported files.
+             * 
+             * @throw Throws a CVFSException on error or if a node name isn't a valid name on the host, e.g. "..".
+             */
+            size_t ExportTree(const std::string &Path, const std::string &HostPath)
+            {
+                namespace fs = std::filesystem;
+                auto node = GetNodeInfo(Path);
+                if(!node)
+                    throw CVFSException("Can't export tree. Node doesn't exists.", VFSError::NODE_DOESNT_EXISTS);
+                else if(!node->IsDir())
+                    throw CVFSException("Can't export tree. Node is a file.", VFSError::NODE_IS_FILE);
+
+                //Names of images, archives or the api could leave the destination, e.g. "..", or replace it, e.g. an absolute path.
+                fs::path Root = fs::path(HostPath).lexically_normal();
+                auto Join = [&Root](const fs::path &Dir, const std::string &Name)
+                {
+                    fs::path Ret = Dir / Name;
+                    if(Name.empty() || Name == "." || Name == ".." || Name.find_first_of("/\\") != std::string::npos)
+                        throw CVFSException("Can't export tree. Invalid name for the host: " + Name, VFSError::INVALID_DESTINATION);
+
+                    auto Rel = Ret.lexically_normal().lexically_relative(Root);
+                    if(Rel.empty() || *Rel.begin() == "..")
+                        throw CVFSException("Can't export tree. Path leaves the destination: " + Ret.string(), VFSError::INVALID_DESTINATION);
+
+                    return Ret;
+                };
+
+                //Creates the directories and collects the files. Created gets the directories in the order they are created.
+                std::vector<std::pair<VFSFile, fs::path>> Files;
+                std::vector<std::pair<VFSDir, fs::path>> Dirs = {{std::static_pointer_cast<CVFSDir>(node), fs::path(HostPath)}};
+                std::vector<std::pair<VFSDir, fs::path>> Created;
+                while (!Dirs.empty())
+                {
+                    auto Dir = Dirs.back();
+                    Dirs.pop_back();
+                    Created.push_back(Dir);
+
+                    std::error_code Error;
+                    fs::create_directories(Dir.second, Error);
+                    if(Error)
+                        throw CVFSException("Can't export tree. Can't create host directory: " + Dir.second.string(), VFSError::HOST_IO_FAILED);
+
+                    for (auto &&e : Dir.first->GetChilds())
+                    {
+                        if(e->IsDir())
+                            Dirs.push_back({std::static_pointer_cast<CVFSDir>(e), Join(Dir.second, e->Name())});
+                        else
+                            Files.push_back({std::static_pointer_cast<CVFSFile>(e), Join(Dir.second, e->Name())});
+                    }
+                }
+
+                ForEachParallel(Files.size(), [&](size_t i)
+                {
+                    auto &Host = Files[i].second;
+                    std::FILE *File = std::fopen(Host.string().c_str(), "wb");
+                    if(!File)
+                        throw CVFSException("Can't export tree. Can't create host file: " + Host.string(), VFSError::HOST_IO_FAILED);
+
+                    time_t Modified;
+                    bool Ok = Files[i].first->Store(File, Modified);
+                    Ok = (std::fclose(File) == 0) && Ok;
+
+                    std::error_code Error;
+                    if(Ok)
+                        fs::last_write_time(Host, FromTime(Modified), Error);
+
+                    if(!Ok || Error)
+                        throw CVFSException("Can't export tree. Can't write host file: " + Host.string(), VFSError::HOST_IO_FAILED);
+                });
+
+                //Creating the childs changed the times of the host directories. The deepest directories are set first,
+                //so a parent isn't changed afterwards.
+                for (size_t i = Created.size(); i-- > 0;)
+                {
+                    std::error_code Error;
+                    fs::last_write_time(Created[i].second, FromTime(Created[i].first->Created()), Error);
+                    if(Error)
+                        throw CVFSException("Can't export tree. Can't write host directory: " + Created[i].second.string(), VFSError::HOST_IO_FAILED);
+                }
+
+                return Files.size();
+            }
+#endif
+
+            /**
+             * @brief Imports a tar archive from a stream in one pass.
+             * 
+             * The data of each file is read straight from the stream into its extents. New nodes are collected per directory
+             * and merged into each directory with one lock acquisition after the whole archive is read.
+             * Existing files are overwritten and missing parent directories are created. ustar, pax extended headers and
+             * GNU long names are supported, links and special files are skipped.
+             * 
+             * @param Stream: Stream of the archive.
+             * @param Path: Destination directory, it is created if it doesn't exists.
+             * 
+             * @return Returns the count of imported files.
+             * 
+             * @throw Throws a CVFSException, if the archive is damaged or truncated, a path of the archive contains ".." or is a node of another type.
+             * No new nodes are added then, but already overwritten files stay overwritten.
+             */
+            size_t ImportTar(std::istream &Stream, const std::string &Path)
+            {
+                const uint64_t MAX_HEADER_DATA = 1024 * 1024;
+                CheckWritable();
+                if(Path != "/")
+                    CreateDir(Path, true);
+
+                STarImport Import;
+                Import.Dirs.push_back({std::static_pointer_cast<CVFSDir>(GetNodeInfo(Path)), {}});
+                Import.Index[""] = 0;
+
+                auto Read = [&Stream](char *Buf, size_t Count)
+                {
+                    Stream.read(Buf, Count);
+                    return (size_t)Stream.gcount();
+                };
+
+                auto Skip = [&Stream](uint64_t Count)
+                {
+                    Stream.ignore((std::streamsize)Count);
+                    if((uint64_t)Stream.gcount() != Count)
+                        throw CVFSException("Can't import tar. Archive is truncated.", VFSError::FAILED_TO_READ_STREAM);
+                };
+
+                size_t Files = 0;
+                char Block[CVFSTar::BLOCK_SIZE];
+                CVFSTar::SEntry Entry;
+                std::string Pax, LongName;
+                while (true)
+                {
+                    //An archive, which ends without the end blocks, is accepted.
+                    size_t Count = Read(Block, CVFSTar::BLOCK_SIZE);
+                    if(Count == 0)
+                        break;
+                    else if(Count != CVFSTar::BLOCK_SIZE)
+                        throw CVFSException("Can't import tar. Archive is truncated.", VFSError::FAILED_TO_READ_STREAM);
+
+                    if(!CVFSTar::ParseHeader(Block, Entry))
+                        break;
+
+                    //Extended headers apply to the next entry.
+                    if(Entry.Type == 'x' || Entry.Type == 'L')
+                    {
+                        if(Entry.Size > MAX_HEADER_DATA)
+                            throw CVFSException("Can't import tar. Extended header is too large.", VFSError::FAILED_TO_READ_STREAM);
+
+                        std::string Data((size_t)Entry.Size, '\0');
+                        if(Read(&Data[0], Data.size()) != Data.size())
+                            throw CVFSException("Can't import tar. Archive is truncated.", VFSError::FAILED_TO_READ_STREAM);
+
+                        Skip(CVFSTar::Padding(Entry.Size));
+                        if(Entry.Type == 'x')
+                            Pax = std::move(Data);
+                        else
+                            LongName = Data.c_str();
+
+                        continue;
+                    }
+
+                    if(!LongName.empty())
+                        Entry.Path = std::move(LongName);
+
+                    CVFSTar::ParsePax(Pax, Entry);
+                    Pax.clear();
+                    LongName.clear();
+
+                    //"." and empty names are skipped, so "./dir/file" and "dir/file" are the same path. ".." would leave the destination.
+                    auto Names = SplitPath(Entry.Path);
+                    Names.erase(std::remove(Names.begin(), Names.end(), "."), Names.end());
+                    if(std::find(Names.begin(), Names.end(), "..") != Names.end())
+                        throw CVFSException("Can't import tar. Path leaves the destination: " + Entry.Path, VFSError::INVALID_DESTINATION);
+
+                    bool IsFile = Entry.Type == '0' || Entry.Type == '\0' || Entry.Type == '7';
+                    if(Entry.Type == '5' && !Names.empty())
+                        TarDir(Import, Names, Names.size());
+                    else if(IsFile && !Names.empty())
+                    {
+                        std::string Name = Names.back();
+                        size_t Dir = TarDir(Import, Names, Names.size() - 1);
+                        auto node = TarLookup(Import, Dir, Name);
+                        if(node && node->IsDir())
+                            throw CVFSException("Can't import tar. A directory with the name of a file already exists: " + Entry.Path, VFSError::CANT_CREATE_FILE);
+
+                        auto File = std::static_pointer_cast<CVFSFile>(node);
+                        if(File)
+                            Reclaim(File->Detach());
+                        else
+                        {
+                            File = std::make_shared<CVFSFile>(m_Names->Intern(Name));
+                            Import.Dirs[Dir].second[Name] = File;
+                        }
+
+                        if(File->Load((size_t)Entry.Size, Entry.Modified, Read) != Entry.Size)
+                            throw CVFSException("Can't import tar. Archive is truncated.", VFSError::FAILED_TO_READ_STREAM);
+
+                        Skip(CVFSTar::Padding(Entry.Size));
+                        Files++;
+                        continue;
+                    }
+
+                    Skip(Entry.Size + CVFSTar::Padding(Entry.Size));
+                }
+
+                //Deeper directories are filled first, so a new subtree appears complete.
+                std::vector<std::shared_ptr<void>> Garbage;
+                {
+                    std::shared_lock<StructureMutex> Structure(m_StructureLock);
+                    for (size_t i = Import.Dirs.size(); i-- > 0;)
+                    {
+                        if(!Import.Dirs[i].second.empty())
+                            Import.Dirs[i].first->AppendChilds(Import.Dirs[i].second, Garbage);
+                    }
+                }
+
+                if(!Garbage.empty())
+                    Reclaim(std::make_shared<std::vector<std::shared_ptr<void>>>(std::move(Garbage)));
+
+                return Files;
+            }
+
+            /**
+             * @brief Writes a directory tree as tar archive in the ustar format to a stream.
+             * 
+             * The tree is walked depth first in name order. Each file is captured once and written extent by extent,
+             * so only the data of the current file is referenced and nothing is copied. Paths and sizes which don't fit into
+             * the ustar header get a pax extended header.
+             * 
+             * @param Path: Directory inside the filesystem. The paths inside the archive are relative to it.
+             * @param Stream: Destination stream.
+             * 
+             * @return Returns the count of exported files.
+             * 
+             * @throw Throws a CVFSException, if the node doesn't exists, is a file or the stream fails.
+             */
+            size_t ExportTar(const std::string &Path, std::ostream &Stream)
+            {
+                static const char ZEROS[CVFSTar::BLOCK_SIZE * 2] = {};
+                auto node = GetNodeInfo(Path);
+                if(!node)
+                    throw CVFSException("Can't export tar. Node doesn't exists.", VFSError::NODE_DOESNT_EXISTS);
+                else if(!node->IsDir())
+                    throw CVFSException("Can't export tar. Node is a file.", VFSError::NODE_IS_FILE);
+
+                char Block[CVFSTar::BLOCK_SIZE];
+                auto WriteHeader = [&](const std::string &Name, uint64_t Size, time_t Modified, char Type)
+                {
+                    std::string Pax = CVFSTar::PaxRecords(Name, Size);
+                    if(!Pax.empty())
+                    {
+                        CVFSTar::FormatHeader(Block, "PaxHeader", Pax.size(), Modified, 'x');
+                        Stream.write(Block, CVFSTar::BLOCK_SIZE);
+                        Stream.write(Pax.data(), Pax.size());
+                        Stream.write(ZEROS, CVFSTar::Padding(Pax.size()));
+                    }
+
+                    CVFSTar::FormatHeader(Block, Name, Size, Modified, Type);
+                    Stream.write(Block, CVFSTar::BLOCK_SIZE);
+                };
+
+                //Pending nodes with their path inside the archive. The childs are pushed in reverse order, so they are written sorted.
+                size_t Files = 0;
+                std::vector<std::pair<VFSNode, std::string>> Nodes;
+                auto PushChilds = [&Nodes](const VFSDir &Dir, const std::string &Prefix)
+                {
+                    auto Childs = Dir->GetChilds();
+                    for (auto IT = Childs.rbegin(); IT != Childs.rend(); IT++)
+                        Nodes.push_back({*IT, Prefix + (*IT)->Name()});
+                };
+
+                PushChilds(std::static_pointer_cast<CVFSDir>(node), "");
+                while (!Nodes.empty() && Stream)
+                {
+                    auto Cur = std::move(Nodes.back());
+                    Nodes.pop_back();
+
+                    if(Cur.first->IsDir())
+                    {
+                        WriteHeader(Cur.second + "/", 0, Cur.first->Created(), '5');
+                        PushChilds(std::static_pointer_cast<CVFSDir>(Cur.first), Cur.second + "/");
+                        continue;
+                    }
+
+                    uint64_t Size;
+                    time_t Modified;
+                    std::string Inline;
+                    auto Extents = std::static_pointer_cast<CVFSFile>(Cur.first)->GetExtents(Size, Modified, Inline);
+
+                    WriteHeader(Cur.second, Size, Modified, '0');
+                    Stream.write(Inline.data(), Inline.size());
+                    for (auto &&e : Extents)
+                        Stream.write(e.Data->Data, e.Data->Filled);
+
+                    Stream.write(ZEROS, CVFSTar::Padding(Size));
+                    Files++;
+                }
+
+                Stream.write(ZEROS, sizeof(ZEROS));
+                if(!Stream)
+                    throw CVFSException("Can't export tar. Can't write to the stream.", VFSError::HOST_IO_FAILED);
+
+                return Files;
+            }
+
+            /**
+             * @return Returns the complete filesystem as stream.
+             * 
+             * @attention This function allocates new memory for saving the filesystem.
+             * @throw Throws a CVFSException on out of memory.
+             */
+            std::vector<char> Serialize()
+            {
+                VFS_MEASURE(VFSOp::SERIALIZE);
+                try
+                {
+                    VFSFile Disk = std::make_shared<CVFSFile>(m_Names->Intern("stream"));
+                    Disk->Clear();
+
+                    auto Childs = m_Root->GetChilds();
+                    uint64_t Entries = Childs.size();
+                    std::string Header = MAGIC;
+                    Header.append((char*)&Entries, sizeof(Entries));
+                    WriteRecord(Disk.get(), Header);
+                    FillSpace(Disk.get(), DISK_CHUNK_SIZE - Header.size());
+
+                    for (auto e : Childs)
+                        SerializeNode(Disk.get(), e.get());
+
+                    std::vector<char> Ret;
+                    Ret.resize(Disk->Size());
+                    Disk->InternalRead(&Ret[0], Ret.size(), 0);
+                    return Ret;
+                }
+                catch(const std::bad_alloc &e)
+                {
+                    throw CVFSException("Can't create stream. Out of mem. bad_alloc: " + std::string(e.what()), VFSError::OUT_OF_MEM);
+                }
+            }
+
+            /**
+             * @brief Loads an image of Serialize into this filesystem. Images of older versions without checksums are also accepted.
+             * 
+             * The checksums of the nodes are always verified while loading. The file data is copied and verified in parallel on the executor.
+             * Nothing is added to the filesystem, if the image is damaged.
+             * 
+             * @param Data: Image of Serialize.
+             * @param Verify: With VFSVerify::LAZY, the file data is verified on the first access of each file instead.
+             * 
+             * @throw Throws a CVFSException on out of memory or if the image is damaged.
+             */
+            void Deserialize(const std::vector<char> &Data, VFSVerify Verify = VFSVerify::EAGER)
+            {
+                VFS_MEASURE(VFSOp::DESERIALIZE);
+                CheckWritable();
+                try
+                {
+                    size_t Pos = 0;
+                    uint64_t Entries = 0;
+                    std::string FileMagic;
+                    FileMagic.resize(MAGIC.size());
+
+                    ReadVector(Data, &FileMagic[0], FileMagic.size(), Pos);
+                    if(FileMagic == LEGACY_MAGIC)
+                    {
+                        ReadVector(Data, (char*)&Entries, sizeof(Entries), Pos);
+
+                        //Skips the sector.
+                        Pos += (DISK_CHUNK_SIZE - (MAGIC.size() + sizeof(Entries)));
+
+                        std::shared_lock<StructureMutex> Structure(m_StructureLock);
+                        for (size_t i = 0; i < Entries; i++)
+                            m_Root->AppendChild(DeserializeLegacyNode(Data, Pos));
+
+                        return;
+                    }
+                    else if(FileMagic != MAGIC)
+                        throw CVFSException("Can't create filesystem.", VFSError::CANT_CREATE_FILESYSTEM);
+
+                    ReadVector(Data, (char*)&Entries, sizeof(Entries), Pos);
+                    if(!VerifyRecord(Data, 0, Pos))
+                        throw CVFSException("Can't create filesystem. Checksum mismatch of the header.", VFSError::CHECKSUM_MISMATCH);
+
+                    Pos = DISK_CHUNK_SIZE;
+                    CheckCount(Data, Pos, Entries);
+
+                    SLoadContext Context;
+                    Context.Verify = Verify;
+                    std::vector<VFSNode> Nodes;
+                    for (size_t i = 0; i < Entries; i++)
+                        Nodes.push_back(DeserializeNode(Data, Pos, Context));
+
+                    auto &Jobs = Context.Jobs;
+                    ForEachParallel(Jobs.size(), [&Jobs, Verify](size_t i)
+                    {
+                        LoadData(Jobs[i], Verify);
+                    });
+
+                    std::shared_lock<StructureMutex> Structure(m_StructureLock);
+                    for (auto &&e : Nodes)
+                        m_Root->AppendChild(e);
+                }
+                catch(const std::bad_alloc &e)
+                {
+                    throw CVFSException("Can't create filesystem. Out of mem. bad_alloc: " + std::string(e.what()), VFSError::OUT_OF_MEM);
+                }
+            }
+
+            size_t ReadVector(const std::vector<char> &Data, char *Buf, size_t Size, size_t &Pos)
+            {
+                if(Pos > Data.size() || Size > Data.size() - Pos)
+                   throw CVFSException("Can't create filesystem. Unexpected end of the image.", VFSError::FAILED_TO_READ_STREAM);
+
+                memcpy(Buf, Data.data() + Pos, Size);
+                Pos += Size;
+
+                return Size;
+            }
+
+            ~CBasicVFS() 
+            {
+                //Finishes the tasks, which are still referencing this filesystem. Other tasks of a shared executor aren't waited for.
+                //A worker of the executor can't wait, the tasks could be queued behind it. Async operations must be finished before then.
+                auto Executor = m_Executor;
+                if(Executor && Executor->IsWorker())
+                    return;
+
+                std::unique_lock<std::mutex> lock(m_TaskLock);
+                m_TasksDone.wait(lock, [this]() { return m_Tasks == 0; });
+            }
+        private:
+            const std::string MAGIC = "CVFS-DSK2";          //Image with checksums.
+            const std::string LEGACY_MAGIC = "CVFS-DISK";   //Image without checksums, which is only read.
+            const int DISK_CHUNK_SIZE = 128;
+            const size_t PARALLEL_LOAD_SIZE = 64 * 1024;   //Files of this size are loaded in parallel, smaller ones while their record is read.
+            const std::string NODE_IDENTIFIER = "NODE";
+
+            /**
+             * @brief Size and checksum of a part of the file data inside an image.
+             */
+            struct SChecksum
+            {
+                uint64_t Size;
+                uint32_t Crc;
+            };
+
+            /**
+             * @brief File data which Deserialize copies from the image into a file.
+             */
+            struct SLoadJob
+            {
+                char *Dest;
+                const char *Src;
+                size_t Size;
+                uint32_t Crc;
+            };
+
+            /**
+             * @brief State of Deserialize while the nodes are read.
+             */
+            struct SLoadContext
+            {
+                VFSVerify Verify;
+                std::vector<SLoadJob> Jobs;         //File data, which is copied after all nodes are read.
+                std::vector<SChecksum> Checksums;   //Checksums of the current file.
+            };
+
+            class CVFSFile;
+            class CVFSDir;
+
+            using VFSFile = std::shared_ptr<CVFSFile>;
+            using VFSDir = std::shared_ptr<CVFSDir>;
+            
+            class CVFSFile : public CVFSNode
+            {
+                friend CBasicVFS;
+
+                protected:
+                    using CVFSNode::m_Name;
+                    using CVFSNode::m_IsDir;
+                    using CVFSNode::m_Created;
+                    using CVFSNode::m_Accessed;
+                    using CVFSNode::m_UpdateLock;
+                    using CVFSNode::m_Watches;
+                    using CVFSNode::Notify;
+                    using CVFSNode::AddWatch;
+                    using CVFSNode::SetParentWatches;
+
+                public:
+                    CVFSFile() : CVFSNode(), m_Log(nullptr)
+                    {
+                        m_IsDir = false;
+                        m_Modified = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+                        m_Size = 0;
+                        m_Capacity = 0;
+                    }
+
+                    CVFSFile(const VFSName &Name) : CVFSFile()
+                    {
+                        m_Name = Name;
+                    }
+
+                    CVFSFile(const CVFSFile &file, bool KeepTimes = false) : CVFSNode(file, KeepTimes), m_Log(nullptr)
+                    {
+                        std::lock_guard<Mutex> lock(file.m_UpdateLock);
+                        file.Settle();
+                        m_Modified = file.m_Modified;
+                        m_Size = file.m_Size;
+                        m_Capacity = file.m_Capacity;
+
+                        //Shares the chunks, they are copied on the next write (see InternalWrite).
+                        m_Extents = file.Share();
+                        m_Checksums = file.m_Checksums;
+                        if(m_Extents.empty())
+                            memcpy(m_Inline, file.m_Inline, m_Size);
+                    }
+
+                    ~CVFSFile()
+                    {
+                        delete m_Log.load(std::memory_order_relaxed);
+                    }
+
+                    /**
+                     * @brief Clears the file and releases reserved storage.
+                     */
+                    void Clear()
+                    {
+                        std::lock_guard<Mutex> lock(m_UpdateLock);
+                        Settle(true);
+                        m_Extents.clear();
+                        m_Reserved.clear();
+                        m_Checksums = nullptr;
+                        m_Size = 0;
+                    }
+
+                    /**
+                     * @brief Clears the file, like Clear, but hands the storage to the caller.
+                     * 
+                     * @return Returns the old storage, null if the file had none.
+                     */
+                    std::shared_ptr<void> Detach()
+                    {
+                        std::lock_guard<Mutex> lock(m_UpdateLock);
+                        Settle(true);
+                        m_Size = 0;
+                        m_Checksums = nullptr;
+                        if(m_Extents.empty() && m_Reserved.empty())
+                            return nullptr;
+
+                        auto Ret = std::make_shared<std::pair<std::vector<SExtent>, std::vector<Chunk>>>(std::move(m_Extents), std::move(m_Reserved));
+                        m_Extents.clear();
+                        m_Reserved.clear();
+                        return Ret;
+                    }
+
+                    /**
+                     * @brief Allocates storage, so the file can grow up to the given size without allocations on the write path.
+                     * The missing storage is allocated as one chunk.
+                     * 
+                     * @param Bytes: Expected size of the file.
+                     * 
+                     * @throw Throws a CVFSException, if the system is out of memory.
+                     */
+                    void Reserve(size_t Bytes)
+                    {
+                        std::lock_guard<Mutex> lock(m_UpdateLock);
+                        Settle();
+
+                        //Capped files reuse their chunks.
+                        if(m_Capacity > 0)
+                            return;
+
+                        //Inline data moves into the first reserved chunk, so it needs room for the whole file.
+                        size_t Available = m_Extents.empty() ? 0 : m_Size;
+                        if(!m_Extents.empty() && !m_Extents.back().Data->Frozen)
+                            Available += m_Extents.back().Data->Size - m_Extents.back().Data->Filled;
+
+                        for (auto &&e : m_Reserved)
+                            Available += e->Size;
+
+                        if(Bytes <= Available || (m_Extents.empty() && Bytes <= INLINE_SIZE))
+                            return;
+
+                        try
+                        {
+                            m_Reserved.push_back(std::make_shared<SChunk>(Bytes - Available));
+                            m_Extents.reserve(m_Extents.size() + m_Reserved.size());
+                        }
+                        catch(const std::bad_alloc &e)
+                        {
+                            throw CVFSException("Can't reserve storage. Out of mem. bad_alloc: " + std::string(e.what()), VFSError::OUT_OF_MEM);
+                        }
+                    }
+
+                    /**
+                     * @brief Cuts the file to the given size or extends it with zeros. Releases reserved storage and the unused tail of the last chunk.
+                     * 
+                     * @param Size: New size of the file.
+                     */
+                    void Truncate(size_t Size)
+                    {
+                        std::lock_guard<Mutex> lock(m_UpdateLock);
+                        Settle(true);
+                        VerifyData();
+                        m_Reserved.clear();
+
+                        if(Size > m_Size)
+                        {
+                            char Zeros[CHUNK_SIZE] = {};
+                            while (m_Size < Size)
+                                InternalWrite(Zeros, std::min(Size - m_Size, sizeof(Zeros)));
+                        }
+                        else if(Size < m_Size)
+                        {
+                            if(!m_Extents.empty() && Size <= INLINE_SIZE)
+                            {
+                                //Small files move back into the node.
+                                InternalRead(m_Inline, Size, 0);
+                                m_Extents.clear();
+                            }
+                            else if(!m_Extents.empty())
+                            {
+                                auto IT = std::upper_bound(m_Extents.begin(), m_Extents.end(), Size - 1, [](size_t Pos, const SExtent &e)
+                                {
+                                    return Pos < e.Offset;
+                                });
+
+                                m_Extents.erase(IT, m_Extents.end());
+                                SExtent &Last = m_Extents.back();
+                                size_t Filled = Size - Last.Offset;
+                                if(Last.Data->Frozen)
+                                {
+                                    //The shared chunk keeps its size, the file gets its own copy of the rest. Chunks of capped files keep their size.
+                                    auto Copy = std::make_shared<SChunk>(m_Capacity > 0 ? Last.Data->Size : Filled);
+                                    memcpy(Copy->Data, Last.Data->Data, Filled);
+                                    Copy->Filled = Filled;
+                                    Last.Data = Copy;
+                                }
+                                else
+                                    Last.Data->Filled = Filled;
+                            }
+
+                            m_Size = Size;
+                            m_Modified = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+                            Notify(VFSEvent::WRITE, "", "", true);
+                        }
+
+                        //Releases the unused tail of the last chunk, e.g. of a reservation which was too large.
+                        if(!m_Extents.empty() && m_Capacity == 0)
+                        {
+                            SExtent &Last = m_Extents.back();
+                            if(Last.Data->Size - Last.Data->Filled >= CHUNK_SIZE)
+                                Last.Data = Last.Data->Clone(Last.Data->Filled);
+                        }
+                    }
+
+                    /**
+                     * @brief Writes data to the file.
+                     * 
+                     * @param Data: Data to write.
+                     * @param Size: Size of the data.
+                     * 
+                     * @return Returns the size which was written.
+                     */
+                    size_t Write(const char *Data, size_t Size)
+                    {
+                        VFS_MEASURE(VFSOp::WRITE);
+                        std::lock_guard<Mutex> lock(m_UpdateLock);
+                        Settle(true);
+                        return InternalWrite(Data, Size);
+                    }
+
+                    /**
+                     * @brief Appends data without taking the lock, see FileMode::CONCURRENT_APPEND. Each call reserves a range of the file
+                     * with an atomic operation and copies its data into it, so appends of several threads are copied in parallel.
+                     * The data of one call stays contiguous. Readers see it once it and all appends before it are copied.
+                     * Other writes wait for the running appends. The single threaded policy writes normally.
+                     * 
+                     * @param Data: Data to append.
+                     * @param Size: Size of the data.
+                     * 
+                     * @return Returns the size which was written.
+                     */
+                    size_t AppendConcurrent(const char *Data, size_t Size)
+                    {
+                        if(!Policy::THREAD_SAFE)
+                            return Write(Data, Size);
+                        else if(Size == 0)
+                            return 0;
+
+                        VFS_MEASURE(VFSOp::WRITE);
+                        size_t Pos;
+                        SAppendLog *Log = m_Log.load(std::memory_order_acquire);
+                        while (!Log || !Log->Reserve(Size, Pos))
+                        {
+                            //The log is closed or full, the next session starts after the current size.
+                            std::lock_guard<Mutex> lock(m_UpdateLock);
+                            if(Size > SAppendLog::CAPACITY)
+                            {
+                                Settle(true);
+                                return InternalWrite(Data, Size);
+                            }
+
+                            Log = OpenLog(Size);
+                        }
+
+                        Log->Copy(Pos, Data, Size);
+
+                        //Completed segments are folded right away, if the lock is free. Otherwise the lock holder folds them.
+                        if(Log->Commit(Pos, Size) && m_UpdateLock.try_lock())
+                        {
+                            std::lock_guard<Mutex> lock(m_UpdateLock, std::adopt_lock);
+                            Settle();
+                        }
+
+                        VFS_COUNT(BytesWritten, Size);
+                        return Size;
+                    }
+
+                    /**
+                     * @brief Caps the size of the file, e.g. for traces of which only the latest data is needed.
+                     * 
+                     * The data is stored in a ring of chunks, each a sixteenth of the capacity rounded up to 64 bytes. Once the file is full, a write which needs
+                     * a new chunk drops the oldest chunk and reuses it, so writes don't allocate anymore. The file keeps at least the last
+                     * Bytes bytes and less than two chunks more, reads start at the oldest kept byte. A chunk which is shared with a copy or
+                     * snapshot is replaced instead of reused. A file with more data keeps only the last Bytes bytes.
+                     * 
+                     * @param Bytes: Capacity of the file, 0 removes the cap.
+                     */
+                    void SetCapacity(size_t Bytes)
+                    {
+                        std::lock_guard<Mutex> lock(m_UpdateLock);
+                        Settle(true);
+                        VerifyData();
+                        m_Capacity = Bytes;
+                        m_Reserved.clear();
+                        if(Bytes == 0 || m_Size <= Bytes)
+                            return;
+
+                        //Copies the kept data into the chunks of the ring.
+                        size_t Start = m_Size - Bytes;
+                        size_t Size = RingChunkSize();
+                        std::vector<SExtent> Ring;
+                        for (size_t Pos = Start; Pos < m_Size; Pos += Size)
+                        {
+                            auto Data = std::make_shared<SChunk>(Size);
+                            Data->Filled = InternalRead(Data->Data, Size, Pos);
+                            Ring.push_back({Data, Pos - Start});
+                        }
+
+                        m_Extents = std::move(Ring);
+                        m_Size = Bytes;
+                        m_Modified = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+                        Notify(VFSEvent::WRITE, "", "", true);
+                    }
+
+                    /**
+                     * @return Returns the capacity of a capped file, 0 if the file isn't capped.
+                     */
+                    size_t Capacity() const
+                    {
+                        std::lock_guard<Mutex> lock(m_UpdateLock);
+                        return m_Capacity;
+                    }
+
+                    /**
+                     * @brief Writes multiple buffers with one lock acquisition.
+                     * 
+                     * @param Buffers: Data to write.
+                     * 
+                     * @return Returns the size which was written.
+                     */
+                    size_t Write(const std::vector<std::string> &Buffers)
+                    {
+                        VFS_MEASURE(VFSOp::WRITE);
+                        std::lock_guard<Mutex> lock(m_UpdateLock);
+                        Settle(true);
+
+                        size_t Written = 0;
+                        for (auto &&e : Buffers)
+                            Written += InternalWrite(e.data(), e.size());
+
+                        return Written;
+                    }
+
+                    /**
+                     * @brief Appends a vector to the file. Buffers of at least CHUNK_SIZE bytes become file storage without a copy.
+                     * 
+                     * @return Returns the size which was written.
+                     */
+                    size_t Write(std::vector<char> &&Buf)
+                    {
+                        if(Buf.size() < CHUNK_SIZE)
+                            return Write(Buf.data(), Buf.size());
+
+                        auto Keep = std::make_shared<std::vector<char>>(std::move(Buf));
+                        return Adopt(Keep->data(), Keep->size(), SChunk::Owner::VECTOR, Keep);
+                    }
+
+                    /**
+                     * @brief Appends a string to the file. Strings of at least CHUNK_SIZE bytes become file storage without a copy.
+                     * 
+                     * @return Returns the size which was written.
+                     */
+                    size_t Write(std::string &&Buf)
+                    {
+                        if(Buf.size() < CHUNK_SIZE)
+                            return Write(Buf.data(), Buf.size());
+
+                        auto Keep = std::make_shared<std::string>(std::move(Buf));
+                        return Adopt(&(*Keep)[0], Keep->size(), SChunk::Owner::STRING, Keep);
+                    }
+
+                    /**
+                     * @brief Appends memory of the caller to the file. Buffers of at least CHUNK_SIZE bytes become file storage without a copy.
+                     * 
+                     * @param Buf: Memory to take over.
+                     * @param Size: Size of the memory.
+                     * @param Del: Called with Buf, once the file no longer needs the memory.
+                     * 
+                     * @return Returns the size which was written.
+                     */
+                    template<class Deleter>
+                    size_t Write(char *Buf, size_t Size, Deleter Del)
+                    {
+                        std::shared_ptr<char> Keep(Buf, std::move(Del));
+                        if(Size < CHUNK_SIZE)
+                            return Write(Buf, Size);
+
+                        return Adopt(Buf, Size, SChunk::Owner::CALLER, Keep);
+                    }
+
+                    /**
+                     * @brief Moves the data out of the file and clears it.
+                     * If the file consists of one unshared buffer, which was adopted from a Buffer, the buffer is handed back without a copy.
+                     * 
+                     * @return Returns the data as std::string or std::vector<char>.
+                     */
+                    template<class Buffer>
+                    Buffer Take()
+                    {
+                        VFS_MEASURE(VFSOp::READ);
+                        Buffer Ret;
+
+                        std::lock_guard<Mutex> lock(m_UpdateLock);
+                        Settle(true);
+                        VerifyData();
+                        bool Released = m_Extents.size() == 1 && m_Extents[0].Data.use_count() == 1 && m_Extents[0].Data->Release(Ret);
+                        if(!Released && m_Size > 0)
+                        {
+                            Ret.resize(m_Size);
+                            InternalRead(&Ret[0], m_Size, 0);
+                        }
+
+                        m_Extents.clear();
+                        m_Size = 0;
+
+                        m_Modified = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+                        Notify(VFSEvent::WRITE, "", "", true);
+                        return Ret;
+                    }
+
+                    /**
+                     * @brief Adds the memory of this file to a report.
+                     * 
+                     * @param Seen: Chunks which are already counted, chunks which are shared between files are counted once.
+                     * @param Live: Receives the file size.
+                     * @param Allocated: Receives the size of the extents of this file.
+                     */
+                    void Measure(SVFSMemoryReport &Report, std::unordered_set<const void*> &Seen, uint64_t &Live, uint64_t &Allocated) const
+                    {
+                        std::lock_guard<Mutex> lock(m_UpdateLock);
+                        Settle();
+                        Live = m_Size;
+                        Allocated = 0;
+
+                        Report.LiveBytes += m_Size;
+                        Report.NodeBytes += sizeof(CVFSFile) + m_Extents.capacity() * sizeof(SExtent) + m_Reserved.capacity() * sizeof(Chunk);
+                        for (auto &&e : m_Extents)
+                        {
+                            Allocated += e.Data->Size;
+                            if(Seen.insert(e.Data.get()).second)
+                            {
+                                Report.Chunks++;
+                                Report.AllocatedBytes += e.Data->Size;
+                                Report.NodeBytes += sizeof(SChunk);
+                            }
+                        }
+
+                        for (auto &&e : m_Reserved)
+                        {
+                            Report.Chunks++;
+                            Report.AllocatedBytes += e->Size;
+                            Report.ReservedBytes += e->Size;
+                            Report.NodeBytes += sizeof(SChunk);
+                        }
+                    }
+
+                    /**
+                     * @brief Repacks the extents into full chunks, see CVFS::Compact. The data is copied without holding the lock.
+                     * 
+                     * @param Copied: Count of copied bytes, which is increased by this call.
+                     * 
+                     * @return Returns the count of released bytes, 0 if the file is skipped.
+                     */
+                    size_t Compact(size_t &Copied)
+                    {
+                        std::vector<SExtent> Old;
+                        std::unordered_set<const SChunk*> Froze;    //Chunks which this call froze.
+                        size_t Size;
+                        {
+                            std::lock_guard<Mutex> lock(m_UpdateLock);
+                            size_t First = CompactStart();
+                            for (size_t i = First; i < m_Extents.size(); i++)
+                            {
+                                if(m_Extents[i].Data.use_count() > 1)
+                                    return 0;
+                            }
+
+                            //Writers copy frozen chunks, so they stay unchanged while they are copied.
+                            for (size_t i = First; i < m_Extents.size(); i++)
+                            {
+                                if(!m_Extents[i].Data->Frozen.exchange(true))
+                                    Froze.insert(m_Extents[i].Data.get());
+                            }
+
+                            Old.assign(m_Extents.begin() + First, m_Extents.end());
+                            Size = m_Size;
+                        }
+
+                        if(Old.empty())
+                            return 0;
+
+                        size_t Base = Old.front().Offset;
+                        std::vector<SExtent> New;
+                        for (size_t Pos = Base; Size > INLINE_SIZE && Pos < Size; Pos += MAX_EXTENT_SIZE)
+                            New.push_back({std::make_shared<SChunk>(std::min(Size - Pos, (size_t)MAX_EXTENT_SIZE)), Pos});
+
+                        char Inline[INLINE_SIZE];
+                        size_t Target = 0;
+                        for (auto &&e : Old)
+                        {
+                            for (size_t Pos = 0; Pos < e.Data->Filled;)
+                            {
+                                size_t Count = e.Data->Filled - Pos;
+                                if(New.empty())
+                                {
+                                    memcpy(Inline + e.Offset + Pos, e.Data->Data + Pos, Count);
+                                    Pos += Count;
+                                    continue;
+                                }
+
+                                SChunk *c = New[Target].Data.get();
+                                Count = std::min(Count, c->Size - c->Filled);
+                                memcpy(c->Data + c->Filled, e.Data->Data + Pos, Count);
+                                c->Filled += Count;
+                                Pos += Count;
+                                if(c->Filled == c->Size)
+                                    Target++;
+                            }
+                        }
+
+                        std::lock_guard<Mutex> lock(m_UpdateLock);
+                        bool Unchanged = m_Size == Size && m_Extents.size() >= Old.size() && std::equal(Old.begin(), Old.end(), m_Extents.end() - Old.size(), [](const SExtent &a, const SExtent &b)
+                        {
+                            return a.Data == b.Data;
+                        });
+
+                        if(!Unchanged)
+                        {
+                            //Chunks which are only referenced by this file and Old become writable again. Old keeps them alive, so the addresses aren't reused.
+                            for (auto &&e : m_Extents)
+                            {
+                                if(e.Data.use_count() == 2 && Froze.count(e.Data.get()))
+                                    e.Data->Frozen = false;
+                            }
+
+                            return 0;
+                        }
+
+                        size_t Released = 0;
+                        for (auto &&e : Old)
+                            Released += e.Data->Size;
+
+                        for (auto &&e : New)
+                            Released -= e.Data->Size;
+
+                        m_Extents.resize(m_Extents.size() - Old.size());
+                        if(New.empty())
+                            memcpy(m_Inline, Inline, Size);
+                        else
+                            m_Extents.insert(m_Extents.end(), New.begin(), New.end());
+
+                        if(m_Reserved.empty() && m_Extents.capacity() > 2 * m_Extents.size())
+                        {
+                            Released += (m_Extents.capacity() - m_Extents.size()) * sizeof(SExtent);
+                            m_Extents.shrink_to_fit();
+                        }
+
+                        Copied += Size - Base;
+                        return Released;
+                    }
+
+                    /**
+                     * @brief Reads data from the file.
+                     * 
+                     * @param Buf: Buffer which receives the data.
+                     * @param Size: Size of the buffer.
+                     * @param CurPos: Position of inside the file.
+                     * 
+                     * @return Returns the size which was readed.
+                     */
+                    size_t Read(char *Buf, size_t Size, size_t CurPos)
+                    {
+                        VFS_MEASURE(VFSOp::READ);
+                        std::lock_guard<Mutex> lock(m_UpdateLock);
+                        Settle();
+                        return InternalRead(Buf, Size, CurPos);
+                    }
+
+                    /**
+                     * @brief Signals the watches, that a writer closed the file.
+                     */
+                    void CloseWrite()
+                    {
+                        std::lock_guard<Mutex> lock(m_UpdateLock);
+                        Settle();
+                        Notify(VFSEvent::CLOSE_WRITE, "", "", true);
+                    }
+
+                    /**
+                     * @return Returns the last modification time.
+                     */
+                    inline time_t Modified() const
+                    {
+                        std::lock_guard<Mutex> lock(m_UpdateLock);
+                        Settle();
+                        return m_Modified;
+                    }
+
+
+                    inline size_t Size() const
+                    {
+                        std::lock_guard<Mutex> lock(m_UpdateLock);
+                        Settle();
+                        return m_Size;
+                    }
+
+                    /**
+                     * @return Returns a copy of this node.
+                     */
+                    VFSNode Copy(bool KeepTimes = false) override
+                    {
+                        return std::make_shared<CVFSFile>(*this, KeepTimes);
+                    }
+
+                private:
+                    /**
+                     * @brief Appends data to the file without locking.
+                     */
+                    size_t InternalWrite(const char *Data, size_t Size)
+                    {
+                        VerifyData();
+
+                        //A write which fills a capped file replaces its whole content, the beginning of a larger write would be dropped anyway.
+                        size_t Skipped = 0;
+                        if(m_Capacity > 0 && Size >= m_Capacity)
+                        {
+                            Skipped = Size - m_Capacity;
+                            Data += Skipped;
+                            Size = m_Capacity;
+
+                            for (auto &&e : m_Extents)
+                            {
+                                if(Recycle(e.Data))
+                                    m_Reserved.push_back(std::move(e.Data));
+                            }
+
+                            m_Extents.clear();
+                            m_Size = 0;
+                        }
+
+                        size_t Written = 0;
+                        if(m_Extents.empty())
+                        {
+                            //Small files are stored inside the node, they spill into an extent once they outgrow it.
+                            if(m_Size + Size <= INLINE_SIZE)
+                            {
+                                memcpy(m_Inline + m_Size, Data, Size);
+                                m_Size += Size;
+                                Written = Size;
+                            }
+                            else if(m_Size > 0)
+                            {
+                                size_t InlineSize = m_Size;
+                                m_Size = 0;
+                                NextExtent(InlineSize + Size, InlineSize);
+
+                                memcpy(m_Extents.back().Data->Data, m_Inline, InlineSize);
+                                m_Extents.back().Data->Filled = InlineSize;
+                                m_Size = InlineSize;
+                            }
+                        }
+
+                        while (Written < Size)
+                        {
+                            if(m_Extents.empty() || m_Extents.back().Data->Filled == m_Extents.back().Data->Size)
+                                NextExtent(Size - Written);
+                            else if(m_Extents.back().Data->Frozen) //Chunks which are shared with a copy or snapshot are never modified.
+                                m_Extents.back().Data = m_Extents.back().Data->Clone();
+
+                            SChunk *c = m_Extents.back().Data.get();
+                            size_t Free = c->Size - c->Filled;
+                            size_t CopyCount = ((Size - Written) >= Free) ? Free : (Size - Written);    //Calculate the right copy size.
+
+                            memcpy(c->Data + c->Filled, Data + Written, CopyCount);
+                            c->Filled += CopyCount; //Chunk update
+                            m_Size += CopyCount;  
+                            Written += CopyCount;
+                        }
+
+                        m_Modified = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+                        Notify(VFSEvent::WRITE, "", "", true);
+                        VFS_COUNT(BytesWritten, Written);
+                        return Skipped + Written;
+                    }
+
+                    /**
+                     * @brief Reads data from the file without locking.
+                     */
+                    size_t InternalRead(char *Buf, size_t Size, size_t CurPos)
+                    {
+                        VerifyData();
+                        size_t Readed = 0;
+                        if(CurPos < m_Size && m_Extents.empty())
+                        {
+                            Readed = std::min(m_Size - CurPos, Size);
+                            memcpy(Buf, m_Inline + CurPos, Readed);
+                        }
+                        else if(CurPos < m_Size)
+                        {
+                            //Searches the extent which contains the position, all extents except the last one are full.
+                            auto IT = std::upper_bound(m_Extents.begin(), m_Extents.end(), CurPos, [](size_t Pos, const SExtent &e)
+                            {
+                                return Pos < e.Offset;
+                            });
+
+                            size_t ChunkPos = (IT - m_Extents.begin()) - 1;
+                            size_t Pos = CurPos - m_Extents[ChunkPos].Offset;
+
+                            while (Readed < Size && ChunkPos < m_Extents.size())
+                            {
+                                SChunk *c = m_Extents[ChunkPos].Data.get();
+                                size_t CopyCount = std::min(c->Filled - Pos, Size - Readed);    //Calculate the right copy size.
+                                if(CopyCount == 0)
+                                    break;
+
+                                memcpy(Buf + Readed, c->Data + Pos, CopyCount);
+                                Readed += CopyCount;
+                                ChunkPos++;
+                                Pos = 0;
+                            }
+                        }
+                        
+                        m_Accessed = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+                        VFS_COUNT(BytesRead, Readed);
+                        return Readed;
+                    }
+
+                    /**
+                     * @brief Replaces the data with the content of a host file. The file is read without holding the lock,
+                     * straight into extents of up to MAX_EXTENT_SIZE.
+                     * 
+                     * @param File: Host file, opened for reading.
+                     * @param Size: Size of the host file.
+                     * @param Modified: Modification time of the host file.
+                     * 
+                     * @return Returns false on a read error.
+                     */
+                    bool Load(std::FILE *File, size_t Size, time_t Modified)
+                    {
+                        Load(Size, Modified, [File](char *Buf, size_t Count)
+                        {
+                            return std::fread(Buf, 1, Count, File);
+                        });
+
+                        return !std::ferror(File);
+                    }
+
+                    /**
+                     * @brief Replaces the data with the content of a stream, see Load.
+                     * 
+                     * @param Size: Size of the data.
+                     * @param Modified: Modification time of the data.
+                     * @param Read: Reads into a buffer, gets the buffer and its size and returns the count of read bytes. Zero stops reading.
+                     * 
+                     * @return Returns the count of read bytes, which is less than the size if the stream ended before.
+                     * 
+                     * @throw Throws a CVFSException, if the system is out of memory.
+                     */
+                    template<class Func>
+                    size_t Load(size_t Size, time_t Modified, Func &&Read)
+                    {
+                        //The size can come from an untrusted header, so the storage is only allocated as the data arrives.
+                        char Inline[INLINE_SIZE];
+                        std::vector<SExtent> Extents;
+                        size_t Readed = 0;
+                        while (Readed < Size)
+                        {
+                            char *Buf = Inline + Readed;
+                            size_t Free = Size - Readed;
+                            if(Size > INLINE_SIZE)
+                            {
+                                if(Extents.empty() || Extents.back().Data->Filled == Extents.back().Data->Size)
+                                {
+                                    try
+                                    {
+                                        Extents.push_back({std::make_shared<SChunk>(std::min<size_t>(Free, MAX_EXTENT_SIZE)), Readed});
+                                    }
+                                    catch(const std::bad_alloc &e)
+                                    {
+                                        throw CVFSException("Can't load file. Out of mem. bad_alloc: " + std::string(e.what()), VFSError::OUT_OF_MEM);
+                                    }
+                                }
+
+                                SChunk *c = Extents.back().Data.get();
+                                Buf = c->Data + c->Filled;
+                                Free = c->Size - c->Filled;
+                            }
+
+                            size_t Count = Read(Buf, Free);
+                            if(Count == 0)
+                                break;
+
+                            if(!Extents.empty())
+                                Extents.back().Data->Filled += Count;
+
+                            Readed += Count;
+                        }
+
+                        if(!Extents.empty() && Extents.back().Data->Filled == 0)
+                            Extents.pop_back();
+
+                        std::lock_guard<Mutex> lock(m_UpdateLock);
+                        Settle(true);
+                        m_Reserved.clear();
+                        m_Checksums = nullptr;
+                        m_Extents = std::move(Extents);
+                        if(m_Extents.empty())
+                            memcpy(m_Inline, Inline, Readed);
+
+                        m_Size = Readed;
+                        m_Modified = Modified;
+                        Notify(VFSEvent::WRITE, "", "", true);
+                        VFS_COUNT(BytesWritten, Readed);
+                        return Readed;
+                    }
+
+                    /**
+                     * @brief Writes the data to a host file with one write per extent. The data is captured once, the lock isn't held while writing.
+                     * 
+                     * @param File: Host file, opened for writing.
+                     * @param Modified: Receives the modification time of the captured data.
+                     * 
+                     * @return Returns false on a write error.
+                     */
+                    bool Store(std::FILE *File, time_t &Modified) const
+                    {
+                        uint64_t Size;
+                        std::string Inline;
+                        auto Extents = GetExtents(Size, Modified, Inline);
+
+                        bool Ret = std::fwrite(Inline.data(), 1, Inline.size(), File) == Inline.size();
+                        for (auto &&e : Extents)
+                            Ret = Ret && std::fwrite(e.Data->Data, 1, e.Data->Filled, File) == e.Data->Filled;
+
+                        return Ret;
+                    }
+
+                    /**
+                     * Data chunk.
+                     */
+                    struct SChunk
+                    {
+                        public:
+                            /**
+                             * @brief Owner of the memory of a chunk.
+                             */
+                            enum class Owner
+                            {
+                                CHUNK,
+                                VECTOR,
+                                STRING,
+                                CALLER
+                            };
+
+                            SChunk(size_t ChunkSize = CHUNK_SIZE) : Frozen(false), m_Owner(Owner::CHUNK), m_Checksum(0)
+                            {
+                                Size = ChunkSize;
+                                Filled = 0;
+                                Data = new char[Size];
+
+                                VFS_COUNT(LiveChunks, 1);
+                                VFS_COUNT(ChunkBytes, Size);
+                            }
+
+                            /**
+                             * @brief Adopts the memory of a buffer. The chunk is full and read only.
+                             * 
+                             * @param Buf: Memory of the buffer.
+                             * @param BufSize: Size of the buffer.
+                             * @param Type: Type of the buffer.
+                             * @param Keep: Keeps the buffer alive, it is released together with the chunk.
+                             */
+                            SChunk(char *Buf, size_t BufSize, Owner Type, std::shared_ptr<void> Keep) : Frozen(true), m_Owner(Type), m_Keep(std::move(Keep)), m_Checksum(0)
+                            {
+                                Size = Filled = BufSize;
+                                Data = Buf;
+
+                                VFS_COUNT(LiveChunks, 1);
+                                VFS_COUNT(ChunkBytes, Size);
+                            }
+
+                            SChunk(const SChunk&) = delete;
+                            SChunk &operator=(const SChunk&) = delete;
+
+                            /**
+                             * @return Returns a private copy of this chunk.
+                             */
+                            std::shared_ptr<SChunk> Clone() const
+                            {
+                                return Clone(Size);
+                            }
+
+                            /**
+                             * @return Returns a private copy of this chunk with the given size, which must hold the filled data.
+                             */
+                            std::shared_ptr<SChunk> Clone(size_t NewSize) const
+                            {
+                                auto Ret = std::make_shared<SChunk>(NewSize);
+                                Ret->Filled = Filled;
+                                memcpy(Ret->Data, Data, Filled);
+
+                                return Ret;
+                            }
+
+                            /**
+                             * @brief Empties the chunk, so a capped file can reuse it. The caller must hold the only reference.
+                             * 
+                             * @return Returns false if the memory was adopted from a buffer.
+                             */
+                            bool Recycle()
+                            {
+                                if(m_Owner != Owner::CHUNK)
+                                    return false;
+
+                                Filled = 0;
+                                Frozen = false;
+                                m_Checksum.store(0, std::memory_order_relaxed);
+                                return true;
+                            }
+
+                            /**
+                             * @brief Hands adopted memory back to a buffer of the type it was adopted from. The chunk is empty afterwards.
+                             * 
+                             * @return Returns false if the memory wasn't adopted from a Buffer.
+                             */
+                            template<class Buffer>
+                            bool Release(Buffer &Buf)
+                            {
+                                if(m_Owner != (std::is_same<Buffer, std::string>::value ? Owner::STRING : Owner::VECTOR))
+                                    return false;
+
+                                Buf = std::move(*std::static_pointer_cast<Buffer>(m_Keep));
+                                VFS_COUNT(ChunkBytes, -(int64_t)Size);
+                                Size = Filled = 0;
+                                Data = nullptr;
+                                return true;
+                            }
+
+                            size_t Size;
+                            size_t Filled;
+                            char *Data;
+                            std::atomic<bool> Frozen;   //Set once the chunk is shared, it is read only from then on.
+
+                            ~SChunk()
+                            {
+                                VFS_COUNT(LiveChunks, -1);
+                                VFS_COUNT(ChunkBytes, -(int64_t)Size);
+                                if(m_Owner == Owner::CHUNK)
+                                    delete[] Data;
+                            }
+
+                            /**
+                             * @return Returns the checksum of the filled data. It is cached once the chunk is frozen, e.g. for the next Serialize.
+                             */
+                            uint32_t Checksum()
+                            {
+                                uint64_t Cached = m_Checksum.load(std::memory_order_relaxed);
+                                if(Cached >> 32)
+                                    return (uint32_t)Cached;
+
+                                uint32_t Ret = CVFSCrc32c::Compute(Data, Filled);
+                                if(Frozen)
+                                    m_Checksum.store((uint64_t(1) << 32) | Ret, std::memory_order_relaxed);
+
+                                return Ret;
+                            }
+
+                        private:
+                            Owner m_Owner;
+                            std::shared_ptr<void> m_Keep;
+                            std::atomic<uint64_t> m_Checksum;   //Bit 32 is set, if the lower bits are valid.
+                    };
+
+                    using Chunk = std::shared_ptr<SChunk>;
+
+                    /**
+                     * @brief Chunk and its position inside the file.
+                     */
+                    struct SExtent
+                    {
+                        Chunk Data;
+                        size_t Offset;
+                    };
+
+                    /**
+                     * @brief Append log of AppendConcurrent.
+                     * 
+                     * Writers reserve a range by advancing Tail, copy their data into the segments of the range and commit in the order of their ranges,
+                     * so Committed is the end of the copied prefix. The lock holder folds the committed prefix into the extents, see Settle.
+                     * Segments are allocated before a range is reserved, so a failed allocation never leaves a gap.
+                     * Positions are relative to the start of the session, which is the file size when the log was opened.
+                     * Tail and Allocated carry the generation of the session, so writers which are late never use a range or segment of an old session.
+                     */
+                    struct SAppendLog
+                    {
+                        static const size_t SEGMENT_SIZE = 64 * CHUNK_SIZE;
+                        static const size_t SEGMENTS = 1024;
+                        static const size_t CAPACITY = SEGMENTS * SEGMENT_SIZE; //Size of one session, a full log starts the next one.
+                        static const uint64_t CLOSED = uint64_t(1) << 63;
+                        static const uint64_t POS_MASK = 0xFFFFFFFF;
+
+                        SAppendLog() : Tail(CLOSED), Allocated(0), Committed(0), Waiters(0), Folded(0)
+                        {
+                            for (auto &&e : Segments)
+                                e.store(nullptr, std::memory_order_relaxed);
+                        }
+
+                        SAppendLog(const SAppendLog&) = delete;
+                        SAppendLog &operator=(const SAppendLog&) = delete;
+
+                        ~SAppendLog()
+                        {
+                            for (auto &&e : Segments)
+                                delete e.load(std::memory_order_relaxed);
+                        }
+
+                        /**
+                         * @brief Reserves a range for a writer.
+                         * 
+                         * @param Pos: Receives the start of the range.
+                         * 
+                         * @return Returns false, if the log is closed or has no room for the size.
+                         * 
+                         * @throw Throws std::bad_alloc, if a segment can't be allocated.
+                         */
+                        bool Reserve(size_t Size, size_t &Pos)
+                        {
+                            uint64_t Current = Tail.load(std::memory_order_acquire);
+                            while (true)
+                            {
+                                Pos = Current & POS_MASK;
+                                if((Current & CLOSED) || Size > CAPACITY - Pos)
+                                    return false;
+
+                                uint64_t End = Allocated.load(std::memory_order_acquire);
+                                if(Generation(End) != Generation(Current))
+                                    Current = Tail.load(std::memory_order_acquire);  //The session was restarted.
+                                else if(Pos + Size > (End & POS_MASK))
+                                {
+                                    Grow(End);
+                                    Current = Tail.load(std::memory_order_acquire);
+                                }
+                                else if(Tail.compare_exchange_weak(Current, Current + Size, std::memory_order_acq_rel, std::memory_order_acquire))
+                                    return true;
+                            }
+                        }
+
+                        /**
+                         * @brief Copies the data of a writer into its range.
+                         */
+                        void Copy(size_t Pos, const char *Data, size_t Size)
+                        {
+                            while (Size > 0)
+                            {
+                                size_t Offset = Pos % SEGMENT_SIZE;
+                                size_t Count = std::min<size_t>(Size, SEGMENT_SIZE - Offset);
+                                memcpy((*Segments[Pos / SEGMENT_SIZE].load(std::memory_order_acquire))->Data + Offset, Data, Count);
+
+                                Pos += Count;
+                                Data += Count;
+                                Size -= Count;
+                            }
+                        }
+
+                        /**
+                         * @brief Commits a copied range, after all ranges in front of it are committed.
+                         * 
+                         * @return Returns true if the range completes a segment.
+                         */
+                        bool Commit(size_t Pos, size_t Size)
+                        {
+                            Wait(Pos);
+                            Committed.store(Pos + Size);
+                            if(Waiters.load() > 0)
+                            {
+                                std::lock_guard<std::mutex> lock(WaitLock);
+                                Committing.notify_all();
+                            }
+
+                            return Pos / SEGMENT_SIZE != (Pos + Size) / SEGMENT_SIZE;
+                        }
+
+                        /**
+                         * @return Returns true if the current session has room for the size.
+                         */
+                        bool IsOpen(size_t Size) const
+                        {
+                            uint64_t Current = Tail.load(std::memory_order_acquire);
+                            return !(Current & CLOSED) && Size <= CAPACITY - (Current & POS_MASK);
+                        }
+
+                        /**
+                         * @brief Rejects new ranges and waits until the reserved ones are committed.
+                         */
+                        void Close()
+                        {
+                            Wait(Tail.fetch_or(CLOSED, std::memory_order_acq_rel) & POS_MASK);
+                        }
+
+                        /**
+                         * @brief Starts the next session. The log must be closed and folded.
+                         */
+                        void Reset()
+                        {
+                            uint64_t Next = ((Generation(Tail.load(std::memory_order_relaxed)) + 1) & 0x7FFFFFFF) << 32;
+                            Allocated.store(Next, std::memory_order_release);
+                            for (auto &&e : Segments)
+                                delete e.exchange(nullptr, std::memory_order_acq_rel);
+
+                            Committed.store(0, std::memory_order_relaxed);
+                            Folded = 0;
+                            Piece = nullptr;
+                            Tail.store(Next, std::memory_order_release);
+                        }
+
+                        std::atomic<uint64_t> Tail;         //Closed flag, generation and end of the reserved ranges.
+                        char Padding1[64];
+                        std::atomic<uint64_t> Allocated;    //Generation and end of the allocated segments.
+                        char Padding2[64];
+                        std::atomic<size_t> Committed;      //End of the committed ranges.
+                        char Padding3[64];
+                        std::atomic<uint32_t> Waiters;      //Threads which sleep in Wait.
+                        std::mutex WaitLock;
+                        std::condition_variable Committing;
+                        std::atomic<Chunk*> Segments[SEGMENTS];
+
+                        size_t Folded;  //End of the ranges, which are part of the extents. Only used under the lock of the file, like Piece.
+                        Chunk Piece;    //Last extent of the file, which is a slice of the current segment.
+
+                    private:
+                        /**
+                         * @brief Waits until Committed reaches the position. Spins shortly, because the copy in front is usually short,
+                         * and sleeps afterwards, so a writer which was preempted isn't starved by the waiting ones.
+                         */
+                        void Wait(size_t Pos)
+                        {
+                            const size_t SPINS = 64;
+                            for (size_t i = 0; i < SPINS; i++)
+                            {
+                                if(Committed.load(std::memory_order_acquire) == Pos)
+                                    return;
+                            }
+
+                            Waiters++;
+                            {
+                                std::unique_lock<std::mutex> lock(WaitLock);
+                                Committing.wait(lock, [this, Pos]() { return Committed.load() == Pos; });
+                            }
+
+                            Waiters--;
+                        }
+
+                        static uint64_t Generation(uint64_t Value)
+                        {
+                            return (Value >> 32) & 0x7FFFFFFF;
+                        }
+
+                        /**
+                         * @brief Allocates the segment at the end of the allocated ones. Other writers may do the same, only one wins.
+                         * 
+                         * @param End: The value of Allocated, which is too small.
+                         */
+                        void Grow(uint64_t End)
+                        {
+                            size_t Index = (End & POS_MASK) / SEGMENT_SIZE;
+                            Chunk *Segment = Segments[Index].load(std::memory_order_acquire);
+                            if(!Segment)
+                            {
+                                std::unique_ptr<Chunk> New(new Chunk(std::make_shared<SChunk>((size_t)SEGMENT_SIZE)));
+                                if(Segments[Index].compare_exchange_strong(Segment, New.get(), std::memory_order_acq_rel, std::memory_order_acquire))
+                                    New.release();
+                            }
+
+                            Allocated.compare_exchange_strong(End, End + SEGMENT_SIZE, std::memory_order_acq_rel, std::memory_order_relaxed);
+                        }
+                    };
+
+                    /**
+                     * @brief Starts a session of the append log, creates the log on first use. Must be called under the lock.
+                     * 
+                     * @param Size: Size of the append, which needs room.
+                     * 
+                     * @return Returns the log.
+                     */
+                    SAppendLog *OpenLog(size_t Size)
+                    {
+                        SAppendLog *Log = m_Log.load(std::memory_order_relaxed);
+                        if(!Log)
+                        {
+                            Log = new SAppendLog();
+                            m_Log.store(Log, std::memory_order_release);
+                        }
+                        else if(Log->IsOpen(Size))
+                            return Log; //Another writer started the session.
+
+                        Settle(true);
+                        VerifyData();
+                        Log->Reset();
+                        return Log;
+                    }
+
+                    /**
+                     * @brief Makes the committed appends of AppendConcurrent part of the file. Must be called under the lock, before the data is accessed.
+                     * Folding doesn't change the content of the file, so it's also done for const access.
+                     * 
+                     * @param Close: Also waits for the running appends and closes the log, before the file is changed otherwise. The next append opens it again.
+                     */
+                    void Settle(bool Close = false) const
+                    {
+                        SAppendLog *Log = m_Log.load(std::memory_order_acquire);
+                        if(!Log)
+                            return;
+
+                        if(Close)
+                            Log->Close();
+
+                        const_cast<CVFSFile*>(this)->Fold(*Log);
+                    }
+
+                    /**
+                     * @brief Adds the committed ranges of the log to the extents, as slices of the segments without a copy.
+                     * Small files copy them into the node. Completed segments are released by the log.
+                     */
+                    void Fold(SAppendLog &Log)
+                    {
+                        const size_t SEGMENT_SIZE = SAppendLog::SEGMENT_SIZE;
+                        size_t Committed = Log.Committed.load(std::memory_order_acquire);
+                        if(Log.Folded == Committed)
+                            return;
+
+                        bool Inline = m_Extents.empty() && m_Size + (Committed - Log.Folded) <= INLINE_SIZE;
+                        if(!Inline)
+                            SpillInline();
+
+                        while (Log.Folded < Committed)
+                        {
+                            size_t Index = Log.Folded / SEGMENT_SIZE;
+                            size_t Start = Log.Folded % SEGMENT_SIZE;
+                            size_t End = std::min(SEGMENT_SIZE, Committed - Index * SEGMENT_SIZE);
+                            const Chunk &Segment = *Log.Segments[Index].load(std::memory_order_acquire);
+
+                            if(Inline)
+                                memcpy(m_Inline + m_Size, Segment->Data + Start, End - Start);
+                            else
+                            {
+                                //Grows the slice of the segment, which is the last extent. A copy of the file keeps the old one.
+                                size_t From = Start;
+                                if(Log.Piece && !m_Extents.empty() && m_Extents.back().Data == Log.Piece)
+                                {
+                                    From -= Log.Piece->Size;
+                                    m_Extents.pop_back();
+                                }
+
+                                Log.Piece = std::make_shared<SChunk>(Segment->Data + From, End - From, SChunk::Owner::CALLER, Segment);
+                                m_Extents.push_back({Log.Piece, m_Size - (Start - From)});
+                            }
+
+                            m_Size += End - Start;
+                            Log.Folded += End - Start;
+                            if(End == SEGMENT_SIZE)
+                            {
+                                //Writers never touch a completed segment again, the slices keep its memory.
+                                delete Log.Segments[Index].exchange(nullptr, std::memory_order_acq_rel);
+                                Log.Piece = nullptr;
+                            }
+                        }
+
+                        if(m_Capacity > 0)
+                            DropOldest();
+
+                        m_Modified = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+                        Notify(VFSEvent::WRITE, "", "", true);
+                    }
+
+                    /**
+                     * @brief Captures the data of the file.
+                     * 
+                     * @param Size: Receives the file size.
+                     * @param Modified: Receives the last modification time.
+                     * @param Inline: Receives the data of a file, which is stored inside the node.
+                     * 
+                     * @return Returns the extents of the file. They aren't modified as long as they are referenced.
+                     */
+                    std::vector<SExtent> GetExtents(uint64_t &Size, time_t &Modified, std::string &Inline) const
+                    {
+                        std::lock_guard<Mutex> lock(m_UpdateLock);
+                        Settle();
+                        VerifyData();
+                        Size = m_Size;
+                        Modified = m_Modified;
+                        if(m_Extents.empty())
+                            Inline.assign(m_Inline, m_Size);
+
+                        return Share();
+                    }
+
+                    /**
+                     * @brief Freezes all chunks, so they can be shared. Must be called under the lock.
+                     * 
+                     * @return Returns the extents of the file.
+                     */
+                    std::vector<SExtent> Share() const
+                    {
+                        for (auto &&e : m_Extents)
+                            e.Data->Frozen = true;
+
+                        return m_Extents;
+                    }
+
+                    /**
+                     * @brief Appends a new extent. Extents grow with the file size, from CHUNK_SIZE up to MAX_EXTENT_SIZE.
+                     * 
+                     * @param Needed: Bytes which are going to be written. A larger write gets a larger extent.
+                     */
+                    void AppendExtent(size_t Needed)
+                    {
+                        size_t Size = std::max(std::max(Needed, m_Size), (size_t)CHUNK_SIZE);
+                        Size = std::min(Size, (size_t)MAX_EXTENT_SIZE);
+                        Size = ((Size + CHUNK_SIZE - 1) / CHUNK_SIZE) * CHUNK_SIZE;
+
+                        AppendExtentExact(Size);
+                    }
+
+                    /**
+                     * @brief Appends the next reserved chunk as extent, or a new extent if nothing is reserved.
+                     * 
+                     * @param Needed: Bytes which are going to be written.
+                     * @param Keep: Bytes which are copied into the extent before, the reserved chunk must be larger.
+                     */
+                    void NextExtent(size_t Needed, size_t Keep = 0)
+                    {
+                        if(m_Capacity > 0)
+                        {
+                            auto Reused = DropOldest();
+                            if(!Reused && !m_Reserved.empty())
+                            {
+                                Reused = std::move(m_Reserved.back());
+                                m_Reserved.pop_back();
+                            }
+
+                            if(Reused)
+                                m_Extents.push_back({Reused, m_Size});
+                            else
+                                AppendExtentExact(RingChunkSize());
+
+                            return;
+                        }
+
+                        if(m_Reserved.empty() || m_Reserved.front()->Size <= Keep)
+                            return AppendExtent(Needed);
+
+                        m_Extents.push_back({m_Reserved.front(), m_Size});
+                        m_Reserved.erase(m_Reserved.begin());
+                    }
+
+                    /**
+                     * @return Returns the chunk size of a capped file, a sixteenth of the capacity rounded up to 64 bytes.
+                     */
+                    size_t RingChunkSize() const
+                    {
+                        //Small capacities get small chunks, so the file doesn't hold several times the capacity.
+                        const size_t RING_CHUNK_ALIGN = 64;
+                        size_t Size = std::min<size_t>(std::max<size_t>(m_Capacity / 16, RING_CHUNK_ALIGN), MAX_EXTENT_SIZE);
+                        return ((Size + RING_CHUNK_ALIGN - 1) / RING_CHUNK_ALIGN) * RING_CHUNK_ALIGN;
+                    }
+
+                    /**
+                     * @brief Empties a chunk of a capped file for reuse, if it isn't shared and has the chunk size of the ring.
+                     * 
+                     * @return Returns true if the chunk can be reused.
+                     */
+                    bool Recycle(const Chunk &Data) const
+                    {
+                        return Data.use_count() == 1 && Data->Size == RingChunkSize() && Data->Recycle();
+                    }
+
+                    /**
+                     * @brief Drops the oldest extents of a capped file, as long as the remaining data still fills the capacity. Must be called under the lock.
+                     * 
+                     * @return Returns the oldest dropped chunk, if it can be reused for the next extent. Otherwise null.
+                     */
+                    Chunk DropOldest()
+                    {
+                        size_t Count = 0;
+                        size_t Dropped = 0;
+                        while (Count < m_Extents.size() && m_Size - Dropped - m_Extents[Count].Data->Filled >= m_Capacity)
+                            Dropped += m_Extents[Count++].Data->Filled;
+
+                        if(Count == 0)
+                            return nullptr;
+
+                        Chunk Ret = std::move(m_Extents.front().Data);
+                        if(!Recycle(Ret))
+                            Ret = nullptr;
+
+                        m_Extents.erase(m_Extents.begin(), m_Extents.begin() + Count);
+                        for (auto &&e : m_Extents)
+                            e.Offset -= Dropped;
+
+                        m_Size -= Dropped;
+                        return Ret;
+                    }
+
+                    /**
+                     * @brief Appends a new extent of exactly the given size, e.g. for data of a known size.
+                     */
+                    void AppendExtentExact(size_t Size)
+                    {
+                        m_Extents.push_back({std::make_shared<SChunk>(Size), m_Size});
+                    }
+
+                    /**
+                     * @brief Moves the data, which is stored inside the node, into an extent. Must be called under the lock.
+                     */
+                    void SpillInline()
+                    {
+                        if(!m_Extents.empty() || m_Size == 0)
+                            return;
+
+                        size_t InlineSize = m_Size;
+                        m_Size = 0;
+                        AppendExtentExact(InlineSize);
+
+                        memcpy(m_Extents.back().Data->Data, m_Inline, InlineSize);
+                        m_Extents.back().Data->Filled = InlineSize;
+                        m_Size = InlineSize;
+                    }
+
+                    /**
+                     * @brief Appends a buffer as new extent, without copying it.
+                     * 
+                     * @param Buf: Memory of the buffer.
+                     * @param Size: Size of the buffer.
+                     * @param Type: Type of the buffer, see SChunk::Release.
+                     * @param Keep: Owns the memory, it is released once the file no longer needs it.
+                     * 
+                     * @return Returns the size which was written.
+                     */
+                    size_t Adopt(char *Buf, size_t Size, typename SChunk::Owner Type, std::shared_ptr<void> Keep)
+                    {
+                        VFS_MEASURE(VFSOp::WRITE);
+                        auto Data = std::make_shared<SChunk>(Buf, Size, Type, std::move(Keep));
+
+                        std::lock_guard<Mutex> lock(m_UpdateLock);
+                        Settle(true);
+                        if(m_Capacity > 0)
+                            return InternalWrite(Buf, Size);    //Capped files keep their ring of chunks.
+
+                        VerifyData();
+
+                        //The adopted memory follows the inline data.
+                        SpillInline();
+                        m_Extents.push_back({Data, m_Size});
+                        m_Size += Size;
+
+                        m_Modified = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+                        Notify(VFSEvent::WRITE, "", "", true);
+                        VFS_COUNT(BytesWritten, Size);
+                        return Size;
+                    }
+
+                    /**
+                     * @brief Decides which extents Compact repacks. Must be called under the lock.
+                     * All extents are repacked, if that releases at least an eighth of the file size, e.g. for many small chunks.
+                     * Otherwise only the last extent is repacked, if its unused tail is large enough.
+                     * 
+                     * @return Returns the index of the first extent to repack, the count of extents if the file is compact.
+                     */
+                    size_t CompactStart() const
+                    {
+                        //Each chunk also costs its header and the allocation of its shared pointer.
+                        const size_t CHUNK_OVERHEAD = sizeof(SChunk) + sizeof(SExtent) + 4 * sizeof(void*);
+                        const size_t MIN_RELEASE = CHUNK_SIZE / 4;
+
+                        if(m_Extents.empty() || m_Checksums || m_Capacity > 0)
+                            return m_Extents.size();
+
+                        if(m_Size <= INLINE_SIZE)
+                            return 0;
+
+                        size_t Allocated = m_Extents.size() * CHUNK_OVERHEAD;
+                        for (auto &&e : m_Extents)
+                            Allocated += e.Data->Size;
+
+                        size_t Packed = m_Size + ((m_Size + MAX_EXTENT_SIZE - 1) / MAX_EXTENT_SIZE) * CHUNK_OVERHEAD;
+                        if(Allocated > Packed && Allocated - Packed >= MIN_RELEASE && Allocated - Packed >= m_Size / 8)
+                            return 0;
+
+                        auto &Last = *m_Extents.back().Data;
+                        if(Last.Size - Last.Filled >= MIN_RELEASE)
+                            return m_Extents.size() - 1;
+
+                        return m_Extents.size();
+                    }
+
+                    /**
+                     * @brief Verifies data, which Deserialize loaded with VFSVerify::LAZY. Must be called under the lock, before the data is accessed.
+                     * 
+                     * @throw Throws a CVFSException on a mismatch. The file stays unverified.
+                     */
+                    void VerifyData() const
+                    {
+                        if(!m_Checksums)
+                            return;
+
+                        size_t Offset = 0;
+                        for (auto &&e : *m_Checksums)
+                        {
+                            if(e.Size > m_Size - Offset)
+                                throw CVFSException("Invalid size of extent of file: " + m_Name->Str, VFSError::CHECKSUM_MISMATCH);
+
+                            uint32_t Crc = 0;
+                            for (auto &&x : m_Extents)
+                            {
+                                size_t Begin = std::max(Offset, x.Offset);
+                                size_t End = std::min<size_t>(Offset + e.Size, x.Offset + x.Data->Filled);
+                                if(Begin < End)
+                                    Crc = CVFSCrc32c::Update(Crc, x.Data->Data + (Begin - x.Offset), End - Begin);
+                            }
+
+                            if(Crc != e.Crc)
+                                throw CVFSException("Checksum mismatch of file: " + m_Name->Str, VFSError::CHECKSUM_MISMATCH);
+
+                            Offset += e.Size;
+                        }
+
+                        m_Checksums = nullptr;
+                    }
+
+                    time_t m_Modified;
+                    size_t m_Size;
+                    size_t m_Capacity;  //Maximum size of a capped file, 0 if it isn't capped. See SetCapacity.
+
+                    std::vector<SExtent> m_Extents;     //Empty as long as the data fits into m_Inline.
+                    std::vector<Chunk> m_Reserved;      //Empty chunks of Reserve, used in order by the write path. Capped files keep chunks for reuse here.
+                    mutable std::shared_ptr<const std::vector<SChecksum>> m_Checksums;  //Checksums of the data, until it is verified. See VFSVerify::LAZY.
+                    std::atomic<SAppendLog*> m_Log;     //Null until the file is appended to with AppendConcurrent.
+                    char m_Inline[INLINE_SIZE];
+            };
+
+            class CVFSDir : public CVFSNode
+            {
+                friend CBasicVFS;
+
+                protected:
+                    using CVFSNode::m_Name;
+                    using CVFSNode::m_IsDir;
+                    using CVFSNode::m_Created;
+                    using CVFSNode::m_Accessed;
+                    using CVFSNode::m_UpdateLock;
+                    using CVFSNode::m_Watches;
+                    using CVFSNode::Notify;
+                    using CVFSNode::AddWatch;
+                    using CVFSNode::SetParentWatches;
+
+                public:
+                    CVFSDir() : CVFSNode()
+                    {
+                        m_IsDir = true;
+                    }
+
+                    CVFSDir(const VFSName &Name) : CVFSDir()
+                    {
+                        m_Name = Name;
+                    }
+
+                    CVFSDir(const CVFSDir &dir, bool KeepTimes = false) : CVFSDir(dir, KeepTimes, m_Childs)
+                    {
+                        //The childs are captured under the lock, but copied without holding it.
+                        for (auto &&e : m_Childs)
+                            e = e->Copy(KeepTimes);
+                    }
+
+                    /**
+                     * @brief Copies only the directory itself, the childs are copied by the caller.
+                     * 
+                     * @param Childs: Receives the childs of the source, captured under its lock.
+                     */
+                    CVFSDir(const CVFSDir &dir, bool KeepTimes, std::vector<VFSNode> &Childs) : CVFSNode(dir, KeepTimes)
+                    {
+                        std::lock_guard<Mutex> lock(dir.m_UpdateLock);
+                        Childs = dir.m_Childs;
+                    }
+
+                    /**
+                     * @brief Adds a new child to this directory.
+                     * 
+                     * @param Child: A file or dir to add.
+                     * @param Event: Event for the watches of this directory.
+                     */
+                    void AppendChild(VFSNode Child, VFSEvent Event = VFSEvent::CREATE)
+                    {
+                        std::lock_guard<Mutex> lock(m_UpdateLock);
+                        InternalAppendChild(Child);
+                        LinkChild(Child.get());
+                        Notify(Event, Child->m_Name->Str);
+                    }
+
+                    /**
+                     * @brief Adds a watch to this directory, which also receives the events of the childs.
+                     */
+                    void Watch(const VFSWatch &Watch)
+                    {
+                        std::lock_guard<Mutex> lock(m_UpdateLock);
+                        AddWatch(Watch);
+
+                        for (auto &&e : m_Childs)
+                            LinkChild(e.get());
+                    }
+
+                    /**
+                     * @brief Searches for a node.
+                     * 
+                     * @param Name: Name of the node.
+                     * 
+                     * @return Returns the node of null if the node wasn't found.
+                     */
+                    VFSNode Search(const std::string &Name)
+                    {
+                        size_t NameHash = CVFSNameTable::Hash(Name);
+
+                        std::lock_guard<Mutex> lock(m_UpdateLock);
+                        size_t Pos = Find(Name, NameHash);
+                        return Pos != std::string::npos ? m_Childs[Pos] : nullptr;
+                    }
+
+                    /**
+                     * @brief Adds a new child to this directory, if there is no child with the same name.
+                     * 
+                     * @param Child: A file or dir to add.
+                     * @param Event: Event for the watches of this directory.
+                     * 
+                     * @return Returns false if a child with the same name already exists.
+                     */
+                    bool TryAppendChild(VFSNode Child, VFSEvent Event = VFSEvent::CREATE)
+                    {
+                        auto Name = Child->Interned();
+
+                        std::lock_guard<Mutex> lock(m_UpdateLock);
+                        if(Find(Name->Str, Name->Hash) != std::string::npos)
+                            return false;
+
+                        InternalAppendChild(Child);
+                        LinkChild(Child.get());
+                        Notify(Event, Name->Str);
+                        return true;
+                    }
+
+                    /**
+                     * @brief Adds many childs with one lock acquisition and one merge pass. Existing childs with the same name are replaced.
+                     * 
+                     * @param Added: New childs by their name.
+                     * @param Garbage: Receives the replaced childs, they are released by the caller.
+                     */
+                    void AppendChilds(const std::map<std::string, VFSNode> &Added, std::vector<std::shared_ptr<void>> &Garbage)
+                    {
+                        std::lock_guard<Mutex> lock(m_UpdateLock);
+
+                        std::vector<VFSNode> Childs;
+                        Childs.reserve(m_Childs.size() + Added.size());
+
+                        auto IT = Added.begin();
+                        for (auto &&e : m_Childs)
+                        {
+                            for (; IT != Added.end() && IT->first < e->m_Name->Str; IT++)
+                                Childs.push_back(IT->second);
+
+                            if(IT != Added.end() && IT->first == e->m_Name->Str)
+                            {
+                                Garbage.push_back(e);
+                                Childs.push_back(IT->second);
+                                IT++;
+                            }
+                            else
+                                Childs.push_back(e);
+                        }
+
+                        for (; IT != Added.end(); IT++)
+                            Childs.push_back(IT->second);
+
+                        m_Childs = std::move(Childs);
+
+                        if(m_Watches)
+                        {
+                            for (auto &&e : Added)
+                            {
+                                LinkChild(e.second.get());
+                                Notify(VFSEvent::CREATE, e.first);
+                            }
+                        }
+                    }
+
+                    /**
+                     * @brief Renames and reorders a child. The check and the rename are done under one lock.
+                     * 
+                     * @param Name: Current name of the child.
+                     * @param NewName: New name of the child.
+                     * @param Node: The child, which was resolved by the caller. Null renames any child with the name.
+                     * 
+                     * @throw Throws a CVFSException, if the child doesn't exists, was replaced by another node or a child with the new name already exists.
+                     */
+                    void RenameChild(const std::string &Name, const VFSName &NewName, const CVFSNode *Node = nullptr)
+                    {
+                        size_t NameHash = CVFSNameTable::Hash(Name);
+
+                        std::lock_guard<Mutex> lock(m_UpdateLock);
+                        size_t Pos = Find(Name, NameHash);
+                        if(Pos == std::string::npos || (Node && m_Childs[Pos].get() != Node))
+                            throw CVFSException("Can't rename node. Node doesn't exists.", VFSError::NODE_DOESNT_EXISTS);
+
+                        if(Find(NewName->Str, NewName->Hash) != std::string::npos)
+                            throw CVFSException("Can't rename node. Node already exists.", VFSError::NODE_ALREADY_EXISTS);
+
+                        auto Child = m_Childs[Pos];
+                        m_Childs.erase(m_Childs.begin() + Pos); //Removes the child temporary.
+                        {
+                            std::lock_guard<Mutex> ChildLock(Child->m_UpdateLock);
+                            Child->m_Name = NewName;
+                            Child->Notify(VFSEvent::RENAME, "", NewName->Str);
+                        }
+
+                        InternalAppendChild(Child);
+                        Notify(VFSEvent::RENAME, Name, NewName->Str);
+                    }
+
+                    /**
+                     * @brief Moves a child into another directory. The checks and the move are done while both directories are locked.
+                     * 
+                     * @param Src: Current parent of the child.
+                     * @param Dest: New parent of the child, must be another directory.
+                     * @param Name: Name of the child.
+                     * @param Node: The child, which was resolved and checked by the caller.
+                     * @param NewName: Name of the child inside the new parent.
+                     * @param SrcFirst: Locks the source before the destination. An ancestor must be locked before its descendants.
+                     * 
+                     * @throw Throws a CVFSException, if the child doesn't exists, was replaced by another node or the destination already has a child with the new name.
+                     */
+                    static void MoveChild(CVFSDir &Src, CVFSDir &Dest, const std::string &Name, const CVFSNode &Node, const VFSName &NewName, bool SrcFirst)
+                    {
+                        size_t NameHash = CVFSNameTable::Hash(Name);
+
+                        std::lock_guard<Mutex> FirstLock(SrcFirst ? Src.m_UpdateLock : Dest.m_UpdateLock);
+                        std::lock_guard<Mutex> SecondLock(SrcFirst ? Dest.m_UpdateLock : Src.m_UpdateLock);
+
+                        //Another node may have the name by now, e.g. after a delete and a rename. It could be an ancestor of the destination,
+                        //which mustn't be moved or locked here.
+                        size_t Pos = Src.Find(Name, NameHash);
+                        if(Pos == std::string::npos || Src.m_Childs[Pos].get() != &Node)
+                            throw CVFSException("Can't move node. Source node doesn't exists.", VFSError::NODE_DOESNT_EXISTS);
+
+                        if(Dest.Find(NewName->Str, NewName->Hash) != std::string::npos)
+                            throw CVFSException("Can't move node. Destination node already exists.", VFSError::NODE_ALREADY_EXISTS);
+
+                        auto Child = Src.m_Childs[Pos];
+                        Src.m_Childs.erase(Src.m_Childs.begin() + Pos);
+                        {
+                            std::lock_guard<Mutex> ChildLock(Child->m_UpdateLock);
+                            Child->Notify(VFSEvent::MOVE);
+                            Child->SetParentWatches({});
+                            Child->m_Name = NewName;
+                        }
+
+                        Src.Notify(VFSEvent::MOVE, Name);
+                        Dest.InternalAppendChild(Child);
+                        Dest.LinkChild(Child.get());
+                        Dest.Notify(VFSEvent::MOVE, NewName->Str);
+                    }
+
+                    /**
+                     * @brief Removes a child.
+                     * 
+                     * @param Name: Name of the child.
+                     * @param Event: Event for the watches of this directory and the child.
+                     * 
+                     * @return Returns the removed child, so it isn't released while the lock is held. Returns null if there is no such child.
+                     */
+                    VFSNode RemoveChild(const std::string &Name, VFSEvent Event = VFSEvent::DELETE)
+                    {
+                        size_t NameHash = CVFSNameTable::Hash(Name);
+                        VFSNode Child;
+
+                        std::lock_guard<Mutex> lock(m_UpdateLock);
+                        size_t Pos = Find(Name, NameHash);
+                        if(Pos != std::string::npos)
+                        {
+                            Child = m_Childs[Pos];
+                            m_Childs.erase(m_Childs.begin() + Pos); //Removes the child.
+                            {
+                                std::lock_guard<Mutex> ChildLock(Child->m_UpdateLock);
+                                Child->Notify(Event);
+                                Child->SetParentWatches({});
+                            }
+
+                            Notify(Event, Name);
+                        }
+
+                        return Child;
+                    }
+
+                    /**
+                     * @brief Applies batch operations on childs of this directory with one lock acquisition.
+                     * 
+                     * @param Ops: Operations of CVFS::Apply, which paths are childs of this directory.
+                     * @param Names: Name table of the filesystem.
+                     * @param Garbage: Receives removed childs and replaced file data, they are released by the caller.
+                     */
+                    void Apply(const std::vector<const CVFSBatch::SBatchOp*> &Ops, CVFSNameTable &Names, std::vector<std::shared_ptr<void>> &Garbage)
+                    {
+                        std::lock_guard<Mutex> lock(m_UpdateLock);
+
+                        //Structure changes and file data are staged and committed at the end.
+                        struct SStagedData
+                        {
+                            std::shared_ptr<CVFSFile> File;
+                            bool Truncate;
+                            std::vector<const std::string*> Data;
+                        };
+
+                        std::vector<bool> Removed(m_Childs.size(), false);
+                        std::map<std::string, VFSNode> Added;
+                        std::map<CVFSNode*, SStagedData> Writes;
+                        std::vector<std::pair<VFSEvent, std::pair<std::string, std::string>>> Events;
+
+                        auto Lookup = [&](const std::string &Name) -> VFSNode
+                        {
+                            auto IT = Added.find(Name);
+                            if(IT != Added.end())
+                                return IT->second;
+
+                            size_t Pos = Find(Name, CVFSNameTable::Hash(Name));
+                            if(Pos != std::string::npos && !Removed[Pos])
+                                return m_Childs[Pos];
+
+                            return nullptr;
+                        };
+
+                        auto Remove = [&](const std::string &Name)
+                        {
+                            if(Added.erase(Name) == 0)
+                                Removed[Find(Name, CVFSNameTable::Hash(Name))] = true;
+                        };
+
+                        for (auto &&e : Ops)
+                        {
+                            std::string Name = CBasicVFS::ExtractName(e->Path);
+                            auto node = Lookup(Name);
+
+                            switch (e->Op)
+                            {
+                                case CVFSBatch::BatchOp::CREATE_DIR:
+                                {
+                                    if(node)
+                                        throw CVFSException("Can't create directory", VFSError::CANT_CREATE_DIR);
+
+                                    Added[Name] = std::make_shared<CVFSDir>(Names.Intern(Name));
+                                    Events.push_back({VFSEvent::CREATE, {Name, ""}});
+                                }break;
+
+                                case CVFSBatch::BatchOp::CREATE_FILE:
+                                case CVFSBatch::BatchOp::WRITE:
+                                {
+                                    if(node && node->m_IsDir)
+                                        throw CVFSException("Can't open file. A directory with the given name already exists.", VFSError::CANT_CREATE_FILE);
+
+                                    auto File = std::static_pointer_cast<CVFSFile>(node);
+                                    if(!File)
+                                    {
+                                        File = std::make_shared<CVFSFile>(Names.Intern(Name));
+                                        Added[Name] = File;
+                                        Events.push_back({VFSEvent::CREATE, {Name, ""}});
+                                    }
+
+                                    auto &Staged = Writes[File.get()];
+                                    Staged.File = File;
+                                    if(e->Op == CVFSBatch::BatchOp::CREATE_FILE)
+                                    {
+                                        Staged.Truncate = true;
+                                        Staged.Data.clear();
+                                    }
+
+                                    Staged.Data.push_back(&e->Arg);
+                                }break;
+
+                                case CVFSBatch::BatchOp::RENAME:
+                                {
+                                    if(!node)
+                                        throw CVFSException("Can't rename node. Node doesn't exists.", VFSError::NODE_DOESNT_EXISTS);
+                                    else if(Lookup(e->Arg))
+                                        throw CVFSException("Can't rename node. Node already exists.", VFSError::NODE_ALREADY_EXISTS);
+
+                                    Remove(Name);
+                                    Added[e->Arg] = node;
+                                    Events.push_back({VFSEvent::RENAME, {Name, e->Arg}});
+                                }break;
+
+                                case CVFSBatch::BatchOp::DELETE:
+                                {
+                                    if(!node)
+                                        throw CVFSException("Can't delete node. Node doesn't exists.", VFSError::NODE_DOESNT_EXISTS);
+
+                                    Remove(Name);
+                                    Writes.erase(node.get());
+                                    Events.push_back({VFSEvent::DELETE, {Name, ""}});
+                                }break;
+                            }
+                        }
+
+                        //The data is written before the new files become visible.
+                        for (auto &&e : Writes)
+                        {
+                            if(e.second.Truncate)
+                            {
+                                auto Old = e.second.File->Detach();
+                                if(Old)
+                                    Garbage.push_back(std::move(Old));
+                            }
+
+                            for (auto &&d : e.second.Data)
+                                e.second.File->Write(d->data(), d->size());
+                        }
+
+                        //Merges the remaining and the new childs in one pass.
+                        std::vector<VFSNode> Childs;
+                        Childs.reserve(m_Childs.size() + Added.size());
+
+                        auto IT = Added.begin();
+                        for (size_t i = 0; i < m_Childs.size(); i++)
+                        {
+                            if(Removed[i])
+                            {
+                                Garbage.push_back(m_Childs[i]);
+                                continue;
+                            }
+
+                            for (; IT != Added.end() && IT->first < m_Childs[i]->m_Name->Str; IT++)
+                                Childs.push_back(CommitName(IT->second, Names, IT->first));
+
+                            Childs.push_back(m_Childs[i]);
+                        }
+
+                        for (; IT != Added.end(); IT++)
+                            Childs.push_back(CommitName(IT->second, Names, IT->first));
+
+                        m_Childs = std::move(Childs);
+
+                        if(m_Watches)
+                        {
+                            for (auto &&e : Added)
+                                LinkChild(e.second.get());
+
+                            for (auto &&e : Events)
+                                Notify(e.first, e.second.first, e.second.second);
+                        }
+                    }
+
+                    /**
+                     * @return Returns all childs of this dir.
+                     */
+                    std::vector<VFSNode> GetChilds()
+                    {
+                        std::lock_guard<Mutex> lock(m_UpdateLock);
+                        m_Accessed = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+                        return m_Childs;
+                    }
+
+                    /**
+                     * @brief Gets a range of the sorted childs, without copying the other childs.
+                     *
+                     * @param StartAfter: Only childs which names are greater are returned. Empty to start at the first child.
+                     * @param Prefix: Only childs which names start with the prefix are returned.
+                     * @param Limit: Maximum count of childs.
+                     * @param Childs: Receives the childs.
+                     * @param Last: Receives the name of the last returned child.
+                     */
+                    void GetChilds(const std::string &StartAfter, const std::string &Prefix, size_t Limit, std::vector<VFSNode> &Childs, std::string &Last)
+                    {
+                        std::lock_guard<Mutex> lock(m_UpdateLock);
+                        m_Accessed = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+
+                        //Names with the same prefix are a contiguous range of the sorted childs.
+                        size_t Pos = LowerBound(StartAfter);
+                        if(Pos < m_Childs.size() && m_Childs[Pos]->m_Name->Str == StartAfter)
+                            Pos++;
+
+                        if(StartAfter < Prefix)
+                            Pos = LowerBound(Prefix);
+
+                        for (; Pos < m_Childs.size() && Limit > 0; Pos++, Limit--)
+                        {
+                            const std::string &Name = m_Childs[Pos]->m_Name->Str;
+                            if(Name.compare(0, Prefix.size(), Prefix) != 0)
+                                break;
+
+                            Childs.push_back(m_Childs[Pos]);
+                            Last = Name;
+                        }
+                    }
+
+                    /**
+                     * @return Returns a copy of this node.
+                     */
+                    VFSNode Copy(bool KeepTimes = false) override
+                    {
+                        return std::make_shared<CVFSDir>(*this, KeepTimes);
+                    }
+
+                private:
+                    /**
+                     * @brief Binary search over the sorted childs. Must be called under the lock.
+                     * 
+                     * @param Name: Name of the node to find.
+                     * 
+                     * @return Returns the position of the first child, which name isn't less than the given name.
+                     */
+                    size_t LowerBound(const std::string &Name) const
+                    {
+                        //The names of the childs are only changed under the lock of this directory.
+                        return std::lower_bound(m_Childs.begin(), m_Childs.end(), Name, [](const VFSNode &Child, const std::string &Name)
+                        {
+                            return Child->m_Name->Str < Name;
+                        }) - m_Childs.begin();
+                    }
+
+                    /**
+                     * @brief Searches a child. Must be called under the lock.
+                     * 
+                     * @param Name: Name of the node to find.
+                     * @param NameHash: Hash of the name, see CVFSNameTable::Hash.
+                     * 
+                     * @return Returns the position of the child or std::string::npos.
+                     */
+                    size_t Find(const std::string &Name, size_t NameHash) const
+                    {
+                        size_t Pos = LowerBound(Name);
+                        if(Pos < m_Childs.size() && CVFSNameTable::Equal(m_Childs[Pos]->m_Name, Name, NameHash))
+                            return Pos;
+
+                        return std::string::npos;
+                    }
+
+                    /**
+                     * @brief Passes the watches of this directory to a child. Must be called under the lock.
+                     */
+                    void LinkChild(CVFSNode *Child)
+                    {
+                        if(!m_Watches && !Child->m_Watches)
+                            return;
+
+                        std::lock_guard<Mutex> lock(Child->m_UpdateLock);
+                        Child->SetParentWatches(m_Watches ? m_Watches->Self : std::vector<VFSWatch>());
+                    }
+
+                    /**
+                     * @brief Sets the staged name of a batch node.
+                     */
+                    static VFSNode CommitName(const VFSNode &Node, CVFSNameTable &Names, const std::string &Name)
+                    {
+                        std::lock_guard<Mutex> lock(Node->m_UpdateLock);
+                        if(!Node->m_Name || Node->m_Name->Str != Name)
+                            Node->m_Name = Names.Intern(Name);
+
+                        return Node;
+                    }
+
+                    /**
+                     * @brief Adds a new child to this directory.
+                     * 
+                     * @param Child: A file or dir to add.
+                     */
+                    void InternalAppendChild(VFSNode Child)
+                    {
+                        //Sorts the data ascending.
+                        auto Name = Child->Interned();
+                        m_Childs.insert(m_Childs.begin() + LowerBound(Name->Str), Child);
+                    }
+
+                    std::vector<VFSNode> m_Childs;
+            };
+
+            /**
+             * @brief Splits into a list of names.
+             * 
+             * @param Path: Path to split.
+             * 
+             * @return Returns the path as list.
+             */
+            static std::vector<std::string> SplitPath(const std::string &Path)
+            {
+                size_t Pos = 0;
+                std::vector<std::string> Ret;
+
+                //Ignores the first '/' if it exitst.
+                if(!Path.empty() && Path[0] == '/')
+                    Pos++;
+
+                while (Pos != std::string::npos)
+                {
+                    size_t Start = Pos;
+                    Pos = Path.find('/', Start);
+
+                    std::string Dir = Path.substr(Start, Pos - Start);
+                    
+                    if(!Dir.empty())
+                        Ret.push_back(Dir);
+
+                    if(Pos != std::string::npos)
+                        Pos++;
+                }
+                
+                return Ret;
+            }
+
+            /**
+             * @return Returns a path without the last child e.g Path: /test/test.txt -> ret: /test
+             */
+            static std::string ExtractPath(const std::string &Path)
+            {
+                size_t Pos = Path.find_last_of("/");
+                if(Pos == Path.length() - 1)
+                    Pos = Path.find_last_of("/", Pos - 1);
+
+                //Nodes without a parent path are childs of the root.
+                if(Pos == 0 || Pos == std::string::npos)
+                    return "/";
+
+                return Path.substr(0, Pos);
+            }
+
+            /**
+             * @return Returns the name of the last child
+             */
+            static std::string ExtractName(const std::string &Path)
+            {
+                size_t End = std::string::npos;
+                size_t Pos = Path.find_last_of("/");
+                if(Pos == Path.length() - 1)
+                {
+                    End = Pos - 1;
+                    Pos = Path.find_last_of("/", Pos - 1);
+                }
+
+                return Path.substr(Pos + 1, End - Pos);
+            }
+
+            /**
+             * @brief Releases a deleted node on the executor, so the teardown of a large tree doesn't block the caller.
+             * Small files are released right away.
+             */
+            void Reclaim(VFSNode node)
+            {
+                if(!node->IsDir() && std::static_pointer_cast<CVFSFile>(node)->Size() <= INLINE_SIZE)
+                    return;
+
+                Reclaim(std::shared_ptr<void>(std::move(node)));
+            }
+
+            /**
+             * @brief Queues a task, which references this filesystem, on the executor. The destructor waits for these tasks.
+             */
+            template<class Func>
+            auto SubmitTask(Func &&Task) -> std::future<decltype(Task())>
+            {
+                //Counts the task until it has run or is released without running.
+                struct STaskRef
+                {
+                    CBasicVFS *VFS;
+
+                    STaskRef(CBasicVFS *Owner) : VFS(Owner)
+                    {
+                        std::lock_guard<std::mutex> lock(VFS->m_TaskLock);
+                        VFS->m_Tasks++;
+                    }
+
+                    STaskRef(STaskRef &&Other) : VFS(Other.VFS)
+                    {
+                        Other.VFS = nullptr;
+                    }
+
+                    ~STaskRef()
+                    {
+                        if(!VFS)
+                            return;
+
+                        std::lock_guard<std::mutex> lock(VFS->m_TaskLock);
+                        if(--VFS->m_Tasks == 0)
+                            VFS->m_TasksDone.notify_all();
+                    }
+                };
+
+                //The future keeps the task alive, so the count is released when the task has run.
+                return GetExecutor()->Submit([Ref = STaskRef(this), Task = std::forward<Func>(Task)]() mutable
+                {
+                    STaskRef Running(std::move(Ref));
+                    return Task();
+                });
+            }
+
+            /**
+             * @brief Releases memory on the executor. Blocks while the queue of the executor is full,
+             * so the unreleased memory is bounded. Without a thread safe policy the memory is released right away.
+             */
+            void Reclaim(std::shared_ptr<void> Garbage)
+            {
+                if(!Garbage || !Policy::THREAD_SAFE)
+                    return;
+
+                GetExecutor()->Submit([Garbage = std::move(Garbage)]() mutable
+                {
+                    Garbage.reset();
+                });
+            }
+
+            /**
+             * @brief Calls the task for each index. Runs batches of indices on the executor, if the policy is thread safe.
+             * 
+             * The batches are claimed from a shared counter by the workers and by the calling thread, so busy workers
+             * are balanced by the others and the calling thread never waits for a batch which hasn't started.
+             * Therefore it can also be called from a worker of the executor.
+             * 
+             * @throw Rethrows the first exception of the task, after all started batches are finished. Batches which aren't started yet are skipped.
+             */
+            template<class Func>
+            void ForEachParallel(size_t Count, Func &&Task)
+            {
+                const size_t BATCH_SIZE = 16;
+                auto Executor = Policy::THREAD_SAFE && Count > BATCH_SIZE ? GetExecutor() : nullptr;
+                if(!Executor)
+                {
+                    for (size_t i = 0; i < Count; i++)
+                        Task(i);
+
+                    return;
+                }
+
+                struct SState
+                {
+                    std::atomic<size_t> Next;
+                    size_t Batches;
+                    size_t Finished;
+                    std::atomic<bool> Failed;
+                    std::exception_ptr Error;
+                    std::mutex Lock;
+                    std::condition_variable Done;
+                };
+
+                auto State = std::make_shared<SState>();
+                State->Next = 0;
+                State->Batches = (Count + BATCH_SIZE - 1) / BATCH_SIZE;
+                State->Finished = 0;
+                State->Failed = false;
+
+                //Helpers which start after the last batch don't touch the task anymore, the state is kept alive by them.
+                auto *TaskPtr = &Task;
+                auto Work = [State, TaskPtr, Count, BATCH_SIZE]()
+                {
+                    size_t Batch;
+                    while ((Batch = State->Next.fetch_add(1)) < State->Batches)
+                    {
+                        std::exception_ptr Error;
+                        if(!State->Failed)
+                        {
+                            try
+                            {
+                                size_t End = std::min((Batch + 1) * BATCH_SIZE, Count);
+                                for (size_t i = Batch * BATCH_SIZE; i < End; i++)
+                                    (*TaskPtr)(i);
+                            }
+                            catch(...)
+                            {
+                                Error = std::current_exception();
+                            }
+                        }
+
+                        std::lock_guard<std::mutex> lock(State->Lock);
+                        if(Error && !State->Error)
+                            State->Error = Error;
+
+                        if(Error)
+                            State->Failed = true;
+
+                        if(++State->Finished == State->Batches)
+                            State->Done.notify_all();
+                    }
+                };
+
+                try
+                {
+                    size_t Helpers = std::min(State->Batches - 1, Executor->Threads());
+                    for (size_t i = 0; i < Helpers; i++)
+                        Executor->Submit(Work);
+                }
+                catch(...)
+                {
+                    //The calling thread does the remaining work.
+                }
+
+                Work();
+
+                std::exception_ptr Error;
+                {
+                    std::unique_lock<std::mutex> lock(State->Lock);
+                    State->Done.wait(lock, [&State]() { return State->Finished == State->Batches; });
+
+                    //Late helpers may release the state, but never the exception.
+                    Error = std::move(State->Error);
+                }
+
+                if(Error)
+                    std::rethrow_exception(Error);
+            }
+
+#ifdef CVFS_HAS_FILESYSTEM
+            /**
+             * @return Returns the offset between the clock of the host filesystem and the system clock.
+             */
+            static std::chrono::seconds HostClockOffset()
+            {
+                auto Diff = std::filesystem::file_time_type::clock::now().time_since_epoch() - std::chrono::system_clock::now().time_since_epoch();
+                return std::chrono::round<std::chrono::seconds>(std::chrono::duration_cast<std::chrono::nanoseconds>(Diff));
+            }
+
+            /**
+             * @return Converts a host file time into a time_t.
+             */
+            static time_t ToTime(std::filesystem::file_time_type Time)
+            {
+                return (time_t)std::chrono::floor<std::chrono::seconds>(Time.time_since_epoch() - HostClockOffset()).count();
+            }
+
+            /**
+             * @return Converts a time_t into a host file time.
+             */
+            static std::filesystem::file_time_type FromTime(time_t Time)
+            {
+                return std::filesystem::file_time_type(std::chrono::duration_cast<std::filesystem::file_time_type::duration>(std::chrono::seconds(Time) + HostClockOffset()));
+            }
+#endif
+
+            /**
+             * @brief Fills in padding bytes inside the file.
+             */
+            void FillSpace(CVFSFile *file, size_t Count)
+            {
+                static const char Zeros[CHUNK_SIZE] = {};
+                while (Count > 0)
+                {
+                    size_t Size = std::min(Count, sizeof(Zeros));
+                    file->InternalWrite(Zeros, Size);
+                    Count -= Size;
+                }
+            }
+            
+            /**
+             * @return Returns the count of bytes until the next sector of the image.
+             */
+            size_t SectorSpace(size_t Pos) const
+            {
+                return (DISK_CHUNK_SIZE - Pos % DISK_CHUNK_SIZE) % DISK_CHUNK_SIZE;
+            }
+
+            /**
+             * @brief Writes a record of the image followed by its checksum.
+             */
+            void WriteRecord(CVFSFile *file, std::string &Record)
+            {
+                uint32_t Crc = CVFSCrc32c::Compute(Record.data(), Record.size());
+                Record.append((char*)&Crc, sizeof(Crc));
+                file->InternalWrite(Record.data(), Record.size());
+            }
+
+            /**
+             * @brief Verifies the checksum, which follows a record of the image.
+             * 
+             * @param Start: Start of the record.
+             * @param Pos: End of the record, receives the position after the checksum.
+             * 
+             * @return Returns false on a mismatch.
+             */
+            bool VerifyRecord(const std::vector<char> &Data, size_t Start, size_t &Pos)
+            {
+                size_t End = Pos;
+                uint32_t Crc;
+                ReadVector(Data, (char*)&Crc, sizeof(Crc), Pos);
+                return Crc == CVFSCrc32c::Compute(Data.data() + Start, End - Start);
+            }
+
+            /**
+             * @brief Rejects a count of nodes, which can't fit into the rest of the image. Each node takes at least one sector.
+             */
+            void CheckCount(const std::vector<char> &Data, size_t Pos, uint64_t Count)
+            {
+                if(Pos > Data.size() || Count > (Data.size() - Pos) / DISK_CHUNK_SIZE)
+                    throw CVFSException("Can't create filesystem. Invalid count of nodes.", VFSError::FAILED_TO_READ_STREAM);
+            }
+
+            /**
+             * @brief Copies file data from the image into its file. Verifies the data while copying, unless it is verified lazily.
+             * 
+             * @throw Throws a CVFSException on a mismatch.
+             */
+            static void LoadData(const SLoadJob &Job, VFSVerify Verify)
+            {
+                if(Verify == VFSVerify::LAZY)
+                {
+                    memcpy(Job.Dest, Job.Src, Job.Size);
+                    return;
+                }
+
+                if(CVFSCrc32c::Copy(0, Job.Dest, Job.Src, Job.Size) != Job.Crc)
+                    throw CVFSException("Can't create filesystem. Checksum mismatch of file data.", VFSError::CHECKSUM_MISMATCH);
+            }
+
+            /**
+             * @brief Writes a node and its childs. Each node is a record with its checksum, which starts at a sector.
+             * Files list the size and checksum of each extent, the data follows the record.
+             */
+            void SerializeNode(CVFSFile *file, CVFSNode *Node)
+            {
+                auto Name = Node->Interned();
+                int NameSize = Name->Str.size();
+
+                //The record is built in memory, so its checksum can follow it.
+                std::string Record;
+                auto Put = [&Record](const void *Buf, size_t Size)
+                {
+                    Record.append((const char*)Buf, Size);
+                };
+
+                Put(NODE_IDENTIFIER.data(), NODE_IDENTIFIER.size());
+                Put(&NameSize, sizeof(NameSize));
+                Put(Name->Str.data(), NameSize);
+                Put(&Node->m_IsDir, sizeof(Node->m_IsDir));
+                Put(&Node->m_Created, sizeof(Node->m_Created));
+                Put(&Node->m_Accessed, sizeof(Node->m_Accessed));
+
+                if(Node->IsDir())
+                {
+                    auto Childs = static_cast<CVFSDir*>(Node)->GetChilds();
+
+                    uint64_t EntryCount = Childs.size();
+                    Put(&EntryCount, sizeof(EntryCount));
+                    WriteRecord(file, Record);
+                    FillSpace(file, SectorSpace(file->m_Size));
+
+                    for (auto &&e : Childs)
+                        SerializeNode(file, e.get());
+                }
+                else
+                {
+                    //Captures the data once, the chunks stay unchanged while they are shared.
+                    time_t mtime;
+                    uint64_t Size;
+                    std::string InlineData;
+                    auto Extents = static_cast<CVFSFile*>(Node)->GetExtents(Size, mtime, InlineData);
+
+                    uint32_t Count = InlineData.empty() ? Extents.size() : 1;
+                    Put(&mtime, sizeof(mtime));
+                    Put(&Size, sizeof(Size));
+                    Put(&Count, sizeof(Count));
+
+                    if(!InlineData.empty())
+                    {
+                        SChecksum Sum = {InlineData.size(), CVFSCrc32c::Compute(InlineData.data(), InlineData.size())};
+                        Put(&Sum.Size, sizeof(Sum.Size));
+                        Put(&Sum.Crc, sizeof(Sum.Crc));
+                    }
+
+                    for (auto &&e : Extents)
+                    {
+                        SChecksum Sum = {e.Data->Filled, e.Data->Checksum()};
+                        Put(&Sum.Size, sizeof(Sum.Size));
+                        Put(&Sum.Crc, sizeof(Sum.Crc));
+                    }
+
+                    WriteRecord(file, Record);
+
+                    //Small data follows the record inside its sector, larger data starts at the next sector.
+                    if(Size > SectorSpace(file->m_Size))
+                        FillSpace(file, SectorSpace(file->m_Size));
+
+                    file->InternalWrite(InlineData.data(), InlineData.size());
+                    for (auto &&e : Extents)
+                        file->InternalWrite(e.Data->Data, e.Data->Filled);
+
+                    FillSpace(file, SectorSpace(file->m_Size));
+                }
+            }
+
+            /**
+             * @brief Reads a node of an image of Serialize.
+             * 
+             * @param Context: Receives the file data, which must be copied into the files.
+             */
+            VFSNode DeserializeNode(const std::vector<char> &Data, size_t &Pos, SLoadContext &Context)
+            {
+                size_t Start = Pos;
+                std::string Identifier(NODE_IDENTIFIER.size(), '\0');
+                ReadVector(Data, &Identifier[0], Identifier.size(), Pos);
+                if(Identifier != NODE_IDENTIFIER)
+                    throw CVFSException("Invalied node identifier!", VFSError::CANT_CREATE_FILESYSTEM);
+
+                int NameSize = 0;
+                ReadVector(Data, (char*)&NameSize, sizeof(NameSize), Pos);
+                if(NameSize < 0 || (size_t)NameSize > Data.size() - Pos)
+                    throw CVFSException("Can't create filesystem. Invalid name size.", VFSError::FAILED_TO_READ_STREAM);
+
+                std::string Name(NameSize, '\0');
+                ReadVector(Data, &Name[0], Name.size(), Pos);
+
+                char IsDir;
+                time_t Created;
+                time_t Accessed;
+                ReadVector(Data, &IsDir, sizeof(IsDir), Pos);
+                ReadVector(Data, (char*)&Created, sizeof(Created), Pos);
+                ReadVector(Data, (char*)&Accessed, sizeof(Accessed), Pos);
+
+                if(IsDir)
+                {
+                    uint64_t Entries = 0;
+                    ReadVector(Data, (char*)&Entries, sizeof(Entries), Pos);
+                    if(!VerifyRecord(Data, Start, Pos))
+                    throw CVFSException("Can't create filesystem. Checksum mismatch of node: " + Name, VFSError::CHECKSUM_MISMATCH);
+
+                    auto Dir = std::make_shared<CVFSDir>(m_Names->Intern(Name));
+                    Dir->m_Created = Created;
+                    Dir->m_Accessed = Accessed;
+
+                    Pos += SectorSpace(Pos);
+                    CheckCount(Data, Pos, Entries);
+                    for (size_t i = 0; i < Entries; i++)
+                        Dir->AppendChild(DeserializeNode(Data, Pos, Context));
+
+                    return Dir;
+                }
+
+                time_t mtime;
+                uint64_t Size;
+                uint32_t Count;
+                ReadVector(Data, (char*)&mtime, sizeof(mtime), Pos);
+                ReadVector(Data, (char*)&Size, sizeof(Size), Pos);
+                ReadVector(Data, (char*)&Count, sizeof(Count), Pos);
+                if(Pos > Data.size() || Count > (Data.size() - Pos) / (sizeof(uint64_t) + sizeof(uint32_t)))
+                    throw CVFSException("Can't create filesystem. Invalid count of extents.", VFSError::FAILED_TO_READ_STREAM);
+
+                auto &Checksums = Context.Checksums;
+                Checksums.resize(Count);
+
+                uint64_t Total = 0;
+                for (auto &&e : Checksums)
+                {
+                    ReadVector(Data, (char*)&e.Size, sizeof(e.Size), Pos);
+                    ReadVector(Data, (char*)&e.Crc, sizeof(e.Crc), Pos);
+
+                    //The extents must add up to the size without wrapping around.
+                    if(e.Size > Size - Total)
+                        throw CVFSException("Can't create filesystem. Invalid size of extent of node " + Name, VFSError::FAILED_TO_READ_STREAM);
+
+                    Total += e.Size;
+                }
+
+                if(!VerifyRecord(Data, Start, Pos))
+                    throw CVFSException("Can't create filesystem. Checksum mismatch of node: " + Name, VFSError::CHECKSUM_MISMATCH);
+                if(Total != Size)
+                    throw CVFSException("Can't create filesystem. Invalid size of node " + Name, VFSError::FAILED_TO_READ_STREAM);
+
+                if(Size > SectorSpace(Pos))
+                    Pos += SectorSpace(Pos);
+
+                if(Pos > Data.size() || Size > Data.size() - Pos)
+                    throw CVFSException("Can't create filesystem. Unexpected end of the image.", VFSError::FAILED_TO_READ_STREAM);
+
+                auto File = std::make_shared<CVFSFile>(m_Names->Intern(Name));
+                File->m_Created = Created;
+                File->m_Accessed = Accessed;
+                File->m_Modified = mtime;
+
+                const char *Src = Data.data() + Pos;
+                char *Dest = File->m_Inline;
+                if(Size > INLINE_SIZE)
+                {
+                    File->AppendExtentExact(Size);
+                    Dest = File->m_Extents.back().Data->Data;
+                    File->m_Extents.back().Data->Filled = Size;
+                    if(Context.Verify == VFSVerify::LAZY)
+                        File->m_Checksums = std::make_shared<const std::vector<SChecksum>>(Checksums);
+                }
+
+                File->m_Size = Size;
+
+                //Small files are copied while the image is in the cache, inline files are always verified right away.
+                size_t Offset = 0;
+                for (auto &&e : Checksums)
+                {
+                    SLoadJob Job = {Dest + Offset, Src + Offset, (size_t)e.Size, e.Crc};
+                    if(Size >= PARALLEL_LOAD_SIZE)
+                        Context.Jobs.push_back(Job);
+                    else
+                        LoadData(Job, Size > INLINE_SIZE ? Context.Verify : VFSVerify::EAGER);
+
+                    Offset += e.Size;
+                }
+
+                Pos += Size;
+                Pos += SectorSpace(Pos);
+                return File;
+            }
+
+            /**
+             * @brief Reads a node of an image without checksums.
+             */
+            VFSNode DeserializeLegacyNode(const std::vector<char> &Data, size_t &Pos)
+            {
+                std::string Identifier(NODE_IDENTIFIER.size(), '\0');
+                ReadVector(Data, &Identifier[0], Identifier.size(), Pos);
+                if(Identifier != NODE_IDENTIFIER)
+                    throw CVFSException("Invalied node identifier!", VFSError::CANT_CREATE_FILESYSTEM);
+
+                int NameSize = 0;
+                ReadVector(Data, (char*)&NameSize, sizeof(NameSize), Pos); 
+
+                std::string Name(NameSize, '\0');
+                ReadVector(Data, &Name[0], Name.size(), Pos);
+
+                bool IsDir;
+                ReadVector(Data, (char*)&IsDir, sizeof(IsDir), Pos); 
+
+                time_t Created;
+                time_t Accessed;
+                ReadVector(Data, (char*)&Created, sizeof(Created), Pos); 
+                ReadVector(Data, (char*)&Accessed, sizeof(Accessed), Pos); 
+
+                if(IsDir)
+                {
+                    auto Dir = std::make_shared<CVFSDir>(m_Names->Intern(Name));
+                    Dir->m_Created = Created;
+                    Dir->m_Accessed = Accessed;
+
+                    uint64_t Entries = 0;
+                    ReadVector(Data, (char*)&Entries, sizeof(Entries), Pos); 
+
+                    size_t NodeSize = NODE_IDENTIFIER.size() + sizeof(int) + (int)Dir->m_Name->Str.size() + sizeof(Dir->m_IsDir) + sizeof(Dir->m_Created) + sizeof(Dir->m_Accessed) + sizeof(uint64_t);
+
+                    //Skips the Padding
+                    Pos += DISK_CHUNK_SIZE - NodeSize;
+
+                    for (size_t i = 0; i < Entries; i++)
+                        Dir->AppendChild(DeserializeLegacyNode(Data, Pos));
+            
+                    return Dir;
+                }
+                else
+                {
+                    auto File = std::make_shared<CVFSFile>(m_Names->Intern(Name));
+
+                    time_t mtime;
+                    ReadVector(Data, (char*)&mtime, sizeof(mtime), Pos); 
+
+                    File->m_Created = Created;
+                    File->m_Accessed = Accessed;
+
+                    uint64_t Size;
+                    ReadVector(Data, (char*)&Size, sizeof(Size), Pos);
+
+                    size_t NodeSize = NODE_IDENTIFIER.size() + sizeof(int) + (int)File->m_Name->Str.size() + sizeof(File->m_IsDir) + sizeof(File->m_Created) + sizeof(File->m_Accessed) + sizeof(mtime) + sizeof(Size);
+                    int FillSize = DISK_CHUNK_SIZE - (NodeSize > DISK_CHUNK_SIZE ? (NodeSize - DISK_CHUNK_SIZE) : NodeSize);
+
+                    //Skips the Padding.
+                    if(Size > FillSize)
+                        Pos += FillSize;
+
+                    //Copies the data straight from the stream into one extent.
+                    if(Pos > Data.size())
+                        throw CVFSException("Can't create filesystem.", VFSError::FAILED_TO_READ_STREAM);
+
+                    size_t Count = (size_t)std::min<uint64_t>(Size, Data.size() - Pos);
+                    if(Count > 0)
+                    {
+                        if(Count > INLINE_SIZE)
+                            File->AppendExtentExact(Count);
+
+                        File->InternalWrite(Data.data() + Pos, Count);
+                        Pos += Count;
+                    }
+
+                    File->m_Modified = mtime;
+
+                    //Skips the Padding. Data which ends on a sector boundary isn't padded.
+                    if(Size <= FillSize)
+                        Pos += FillSize - Size;
+                    else if(Size % DISK_CHUNK_SIZE != 0)
+                        Pos += DISK_CHUNK_SIZE - (Size % DISK_CHUNK_SIZE);
+
+                    return File;
+                }
+            }
+
+            /**
+             * @brief Orders the wasters of MemoryReport, so the smallest one is on top of the queue.
+             */
+            struct SWasterOrder
+            {
+                bool operator()(const std::pair<uint64_t, SVFSMemoryReport::SWaster> &a, const std::pair<uint64_t, SVFSMemoryReport::SWaster> &b) const
+                {
+                    return a.first > b.first;
+                }
+            };
+
+            using WasterQueue = std::priority_queue<std::pair<uint64_t, SVFSMemoryReport::SWaster>, std::vector<std::pair<uint64_t, SVFSMemoryReport::SWaster>>, SWasterOrder>;
+
+            void MeasureDir(CVFSDir *Dir, const std::string &Path, SVFSMemoryReport &Report, std::unordered_set<const void*> &Seen, WasterQueue &Top, size_t Wasters)
+            {
+                std::vector<VFSNode> Childs;
+                {
+                    std::lock_guard<Mutex> lock(Dir->m_UpdateLock);
+                    Report.NodeBytes += sizeof(CVFSDir) + Dir->m_Childs.capacity() * sizeof(VFSNode);
+                    Childs = Dir->m_Childs;
+                }
+
+                Report.Dirs++;
+                for (auto &&e : Childs)
+                {
+                    auto Name = e->Interned();
+                    if(Seen.insert(Name.get()).second)
+                        Report.NodeBytes += sizeof(SBasicVFSName<Policy>) + Name->Str.capacity();
+
+                    if(e->IsDir())
+                    {
+                        MeasureDir(static_cast<CVFSDir*>(e.get()), Path + "/" + Name->Str, Report, Seen, Top, Wasters);
+                        continue;
+                    }
+
+                    uint64_t Live, Allocated;
+                    static_cast<CVFSFile*>(e.get())->Measure(Report, Seen, Live, Allocated);
+                    Report.Files++;
+
+                    uint64_t Waste = Allocated > Live ? Allocated - Live : 0;
+                    Report.WastedBytes += Waste;
+                    if(Waste > 0 && Wasters > 0 && (Top.size() < Wasters || Waste > Top.top().first))
+                    {
+                        SVFSMemoryReport::SWaster Waster;
+                        Waster.Path = Path + "/" + Name->Str;
+                        Waster.LiveBytes = Live;
+                        Waster.AllocatedBytes = Allocated;
+
+                        Top.push({Waste, std::move(Waster)});
+                        if(Top.size() > Wasters)
+                            Top.pop();
+                    }
+                }
+            }
+
+            size_t CompactDir(CVFSDir *Dir, size_t Budget, size_t &Copied)
+            {
+                size_t Released = 0;
+                std::vector<VFSNode> Childs;
+                {
+                    std::lock_guard<Mutex> lock(Dir->m_UpdateLock);
+                    auto &Vec = Dir->m_Childs;
+                    if(Vec.capacity() > 2 * Vec.size() + 8)
+                    {
+                        Released += (Vec.capacity() - Vec.size()) * sizeof(VFSNode);
+                        Vec.shrink_to_fit();
+                    }
+
+                    Childs = Vec;
+                }
+
+                for (auto &&e : Childs)
+                {
+                    if(Copied >= Budget)
+                        break;
+
+                    if(e->IsDir())
+                        Released += CompactDir(static_cast<CVFSDir*>(e.get()), Budget, Copied);
+                    else
+                        Released += static_cast<CVFSFile*>(e.get())->Compact(Copied);
+                }
+
+                return Released;
+            }
+
+#ifdef CVFS_ENABLE_STATS
+            void CollectHotDirs(CVFSDir *Dir, const std::string &Path, std::vector<std::pair<std::string, uint64_t>> &HotDirs)
+            {
+                std::string DirPath = Path.empty() ? "/" : Path;
+                if(Dir->m_UpdateLock.Contentions() > 0)
+                    HotDirs.push_back({DirPath, Dir->m_UpdateLock.Contentions()});
+
+                for (auto &&e : Dir->GetChilds())
+                {
+                    if(e->IsDir())
+                        CollectHotDirs(static_cast<CVFSDir*>(e.get()), Path + "/" + e->Name(), HotDirs);
+                }
+            }
+#endif
+
+            /**
+             * @throw Throws a CVFSException, if the filesystem is a readonly snapshot.
+             */
+            inline void CheckWritable() const
+            {
+                if(m_ReadOnly)
+                    throw CVFSException("Filesystem is readonly.", VFSError::FILESYSTEM_IS_READONLY);
+            }
+
+            /**
+             * @brief Walks from a directory to a node.
+             * 
+             * @param Start: Directory to start from.
+             * @param Names: Names of the path, see SplitPath.
+             * @param Trail: Receives the directories which are passed, which are the ancestors of the node.
+             * 
+             * @return Returns the node or null if the node wasn't found. Returns the start directory for an empty path.
+             */
+            static VFSNode Resolve(VFSDir Start, const std::vector<std::string> &Names, std::vector<CVFSNode*> *Trail = nullptr)
+            {
+                VFSNode Ret = Start;
+                for (size_t i = 0; i < Names.size(); i++)
+                {
+                    if(Trail)
+                        Trail->push_back(Start.get());
+
+                    auto node = Start->Search(Names[i]);
+                    if(!node || (i != Names.size() - 1 && !node->IsDir()))
+                        return nullptr;
+
+                    Ret = node;
+                    if(i != Names.size() - 1)   //"Go into" the directory.
+                        Start = std::static_pointer_cast<CVFSDir>(node);
+                }
+
+                return Ret;
+            }
+
+            /**
+             * @brief Walks from a directory to the parent of a node.
+             * 
+             * @param Start: Directory to start from.
+             * @param Path: Relative path to the node.
+             * @param Name: Receives the name of the node.
+             * @param Trail: Receives the ancestors of the parent, see Resolve.
+             * 
+             * @return Returns the parent directory or null if it doesn't exists or the path is empty.
+             */
+            static VFSDir ResolveParent(const VFSDir &Start, const std::string &Path, std::string &Name, std::vector<CVFSNode*> *Trail = nullptr)
+            {
+                auto Names = SplitPath(Path);
+                if(Names.empty())
+                    return nullptr;
+
+                Name = std::move(Names.back());
+                Names.pop_back();
+
+                auto Parent = Resolve(Start, Names, Trail);
+                if(!Parent || !Parent->IsDir())
+                    return nullptr;
+
+                return std::static_pointer_cast<CVFSDir>(Parent);
+            }
+
+            /**
+             * @brief Renames a node, see Rename.
+             * 
+             * @param Start: Directory to start from.
+             * @param Path: Path to the node, relative to the start.
+             * @param Name: New Name of the node.
+             */
+            void RenameNode(const VFSDir &Start, const std::string &Path, const std::string &Name)
+            {
+                std::string OldName;
+                auto Parent = ResolveParent(Start, Path, OldName);
+                if(!Parent)
+                    throw CVFSException("Can't rename node. Node doesn't exists.", VFSError::NODE_DOESNT_EXISTS);
+
+                auto NewName = m_Names->Intern(Name);
+                std::shared_lock<StructureMutex> Structure(m_StructureLock);
+                Parent->RenameChild(OldName, NewName);
+            }
+
+            /**
+             * @brief Deletes a node, see Delete.
+             * 
+             * @param Start: Directory to start from.
+             * @param Path: Path to the node, relative to the start.
+             */
+            void RemoveNode(const VFSDir &Start, const std::string &Path)
+            {
+                std::string Name;
+                auto Parent = ResolveParent(Start, Path, Name);
+                VFSNode node;
+                if(Parent)
+                {
+                    std::shared_lock<StructureMutex> Structure(m_StructureLock);
+                    node = Parent->RemoveChild(Name);
+                }
+
+                if(!node)
+                    throw CVFSException("Can't delete node. Node doesn't exists.", VFSError::NODE_DOESNT_EXISTS);
+
+                Reclaim(std::move(node));
+            }
+
+            /**
+             * @brief Copies a node with all its childs. The tree is copied level by level, the childs of a level are
+             * split into slices, which are copied in parallel on the executor. Small levels are copied by the calling thread,
+             * like whole trees on a machine with one core.
+             * 
+             * The copy isn't linked into any directory, so it can be attached in one step after it is complete.
+             * 
+             * @param KeepTimes: True to keep the times of the nodes.
+             * 
+             * @return Returns the copy.
+             */
+            VFSNode CopyNode(const VFSNode &Node, bool KeepTimes = false)
+            {
+                //Without a second core the recursive copy is faster.
+                if(!Node->IsDir() || !Policy::THREAD_SAFE || std::thread::hardware_concurrency() < 2)
+                    return Node->Copy(KeepTimes);
+
+                struct SLevelDir
+                {
+                    VFSDir Dest;
+                    std::vector<VFSNode> Childs;   //Childs of the source directory.
+                };
+
+                struct SSlice
+                {
+                    size_t Dir;
+                    size_t Start;
+                    size_t End;
+                };
+
+                const size_t SLICE_SIZE = 64;
+
+                std::vector<SLevelDir> Level(1);
+                auto Ret = std::make_shared<CVFSDir>(static_cast<const CVFSDir&>(*Node), KeepTimes, Level[0].Childs);
+                Level[0].Dest = Ret;
+
+                while (!Level.empty())
+                {
+                    std::vector<SSlice> Slices;
+                    for (size_t i = 0; i < Level.size(); i++)
+                    {
+                        size_t Count = Level[i].Childs.size();
+                        Level[i].Dest->m_Childs.resize(Count);
+                        for (size_t Start = 0; Start < Count; Start += SLICE_SIZE)
+                            Slices.push_back({i, Start, std::min(Start + SLICE_SIZE, Count)});
+                    }
+
+                    //Each slice writes only its own positions of the destination, which isn't visible to other threads yet.
+                    std::vector<std::vector<SLevelDir>> Next(Slices.size());
+                    ForEachParallel(Slices.size(), [&Level, &Slices, &Next, KeepTimes](size_t i)
+                    {
+                        auto &Slice = Slices[i];
+                        auto &Dir = Level[Slice.Dir];
+                        for (size_t j = Slice.Start; j < Slice.End; j++)
+                        {
+                            auto &Child = Dir.Childs[j];
+                            if(Child->IsDir())
+                            {
+                                SLevelDir Sub;
+                                Sub.Dest = std::make_shared<CVFSDir>(static_cast<const CVFSDir&>(*Child), KeepTimes, Sub.Childs);
+                                Dir.Dest->m_Childs[j] = Sub.Dest;
+                                Next[i].push_back(std::move(Sub));
+                            }
+                            else
+                                Dir.Dest->m_Childs[j] = Child->Copy(KeepTimes);
+                        }
+                    });
+
+                    Level.clear();
+                    for (auto &&Slice : Next)
+                    {
+                        for (auto &&e : Slice)
+                            Level.push_back(std::move(e));
+                    }
+                }
+
+                return Ret;
+            }
+
+            /**
+             * @brief File of Snapshot, which is copied after the directories are captured.
+             */
+            struct SCapturedFile
+            {
+                CVFSDir *Dest;  //Copy of the parent directory.
+                size_t Pos;     //Position inside the childs of Dest.
+                VFSNode Node;
+                VFSName Name;   //Name at the time of the capture.
+            };
+
+            /**
+             * @brief Copies all directories of a tree and collects its files, see Snapshot. Must be called under the exclusive structure lock.
+             * 
+             * @param Files: Receives the files, their positions inside the copies stay empty.
+             * 
+             * @return Returns the copy of the root.
+             */
+            VFSDir CaptureDirs(const VFSDir &Root, std::vector<SCapturedFile> &Files)
+            {
+                std::vector<std::pair<CVFSDir*, std::vector<VFSNode>>> Pending(1);
+                auto Ret = std::make_shared<CVFSDir>(*Root, true, Pending[0].second);
+                Pending[0].first = Ret.get();
+
+                while (!Pending.empty())
+                {
+                    auto Dest = Pending.back().first;
+                    auto Childs = std::move(Pending.back().second);
+                    Pending.pop_back();
+
+                    Dest->m_Childs.resize(Childs.size());
+                    for (size_t i = 0; i < Childs.size(); i++)
+                    {
+                        auto &Child = Childs[i];
+                        if(Child->IsDir())
+                        {
+                            std::vector<VFSNode> Sub;
+                            auto Copy = std::make_shared<CVFSDir>(static_cast<const CVFSDir&>(*Child), true, Sub);
+                            Dest->m_Childs[i] = Copy;
+                            Pending.emplace_back(Copy.get(), std::move(Sub));
+                        }
+                        else
+                        {
+                            auto Name = Child->Interned();
+                            Files.push_back({Dest, i, std::move(Child), std::move(Name)});
+                        }
+                    }
+                }
+
+                return Ret;
+            }
+
+            /**
+             * @brief Directories of ImportTar with their new childs, which are added after the whole archive is read.
+             */
+            struct STarImport
+            {
+                std::vector<std::pair<VFSDir, std::map<std::string, VFSNode>>> Dirs;
+                std::unordered_map<std::string, size_t> Index;  //Position inside Dirs by the path inside the archive.
+            };
+
+            /**
+             * @brief Gets a directory of ImportTar, missing directories are created.
+             * 
+             * @param Names: Path inside the archive.
+             * @param Count: Count of names of the directory path.
+             * 
+             * @return Returns the position of the directory inside STarImport::Dirs.
+             */
+            size_t TarDir(STarImport &Import, const std::vector<std::string> &Names, size_t Count)
+            {
+                std::string Key;
+                for (size_t i = 0; i < Count; i++)
+                    Key += "/" + Names[i];
+
+                auto IT = Import.Index.find(Key);
+                if(IT != Import.Index.end())
+                    return IT->second;
+
+                size_t Parent = TarDir(Import, Names, Count - 1);
+                auto node = TarLookup(Import, Parent, Names[Count - 1]);
+                if(node && !node->IsDir())
+                    throw CVFSException("Can't import tar. A file with the name of a directory already exists: " + Key, VFSError::CANT_CREATE_DIR);
+                else if(!node)
+                {
+                    node = std::make_shared<CVFSDir>(m_Names->Intern(Names[Count - 1]));
+                    Import.Dirs[Parent].second[Names[Count - 1]] = node;
+                }
+
+                Import.Dirs.push_back({std::static_pointer_cast<CVFSDir>(node), {}});
+                Import.Index[Key] = Import.Dirs.size() - 1;
+                return Import.Dirs.size() - 1;
+            }
+
+            /**
+             * @return Returns a child of a directory of ImportTar, either a new one or an existing one.
+             */
+            static VFSNode TarLookup(STarImport &Import, size_t Dir, const std::string &Name)
+            {
+                auto &Added = Import.Dirs[Dir].second;
+                auto IT = Added.find(Name);
+                if(IT != Added.end())
+                    return IT->second;
+
+                return Import.Dirs[Dir].first->Search(Name);
+            }
+
+            /**
+             * @brief Adds a node to the handle table.
+             * 
+             * @return Returns the id of the handle.
+             */
+            uint64_t AddHandle(VFSNode Node)
+            {
+                std::lock_guard<Mutex> lock(m_HandleLock);
+                uint64_t ID = ++m_LastHandle;
+                m_Handles[ID] = std::move(Node);
+                return ID;
+            }
+
+            /**
+             * @return Returns the directory of a handle.
+             * 
+             * @throw Throws a CVFSException, if the handle doesn't exists or isn't a directory.
+             */
+            VFSDir GetHandleDir(uint64_t Handle)
+            {
+                VFSNode node;
+                {
+                    std::lock_guard<Mutex> lock(m_HandleLock);
+                    auto IT = m_Handles.find(Handle);
+                    if(IT == m_Handles.end())
+                        throw CVFSException("Invalid handle.", VFSError::INVALID_HANDLE);
+
+                    node = IT->second;
+                }
+
+                if(!node->IsDir())
+                    throw CVFSException("Given node is not a directory", VFSError::NODE_IS_FILE);
+
+                return std::static_pointer_cast<CVFSDir>(node);
+            }
+
+            /**
+             * @brief Creates the stream of an opened file. Truncated data is released in the background.
+             */
+            VFSFileStream OpenStream(const VFSFile &file, FileMode mode, size_t Reserve)
+            {
+                if((mode & FileMode::WRITE) == FileMode::WRITE && (mode & FileMode::APPEND) != FileMode::APPEND)
+                    Reclaim(file->Detach());
+
+                VFSFileStream ret = VFSFileStream(new CVFSFileStream(file, mode));
+                ret->Reserve(Reserve);
+                return ret;
+            }
+
+            /**
+             * @brief Creates or opens a file.
+             * 
+             * @return Returns the file or null if the parent directory doesn't exists.
+             */
+            VFSFile OpenFile(const std::string &Path, FileMode mode)
+            {
+                if((mode & FileMode::WRITE) == FileMode::WRITE)
+                    CheckWritable();
+
+                VFSFile ret;
+                auto node = GetNodeInfo(Path);
+                if(node && !node->IsDir())
+                    ret = std::static_pointer_cast<CVFSFile>(node);
+                else if(node && node->IsDir())
+                    throw CVFSException("Can't open file. A directory with the given name already exists.", VFSError::CANT_CREATE_FILE);
+                else if((mode & FileMode::WRITE) == FileMode::WRITE)    //Creates a new file.
+                {
+                    node = GetNodeInfo(ExtractPath(Path));
+                    if(node)
+                    {
+                        ret = std::make_shared<CVFSFile>(m_Names->Intern(ExtractName(Path)));
+                        auto dir = std::static_pointer_cast<CVFSDir>(node);
+                        std::shared_lock<StructureMutex> Structure(m_StructureLock);
+                        dir->AppendChild(ret);
+                    }
+                }
+                else
+                    throw CVFSException("Can't open file. File doesn't exists.", VFSError::CANT_OPEN_FILE);
+
+                return ret;
+            }
+
+            /**
+             * Append which waits for the executor.
+             */
+            struct SPendingAppend
+            {
+                std::string Data;
+                std::promise<size_t> Promise;
+            };
+
+            /**
+             * @brief Writes all pending appends of a file with one open and one lock acquisition.
+             */
+            void FlushAppends(const std::string &Path)
+            {
+                std::vector<SPendingAppend> Pending;
+                {
+                    std::lock_guard<std::mutex> lock(m_PendingLock);
+                    auto IT = m_PendingAppends.find(Path);
+                    if(IT == m_PendingAppends.end())
+                        return;
+
+                    Pending = std::move(IT->second);
+                    m_PendingAppends.erase(IT);
+                }
+
+                try
+                {
+                    auto File = OpenFile(Path, FileMode::WRITE | FileMode::APPEND);
+                    if(!File)
+                        throw CVFSException("Can't create file. Parent directory doesn't exists.", VFSError::CANT_CREATE_FILE);
+
+                    std::vector<std::string> Buffers;
+                    Buffers.reserve(Pending.size());
+                    for (auto &&e : Pending)
+                        Buffers.push_back(std::move(e.Data));
+
+                    File->Write(Buffers);
+                    for (size_t i = 0; i < Pending.size(); i++)
+                        Pending[i].Promise.set_value(Buffers[i].size());
+                }
+                catch(...)
+                {
+                    for (auto &&e : Pending)
+                        e.Promise.set_exception(std::current_exception());
+                }
+            }
+
+            /**
+             * @return Returns the event queue of the watches. Creates it on first use.
+             */
+            std::shared_ptr<CVFSWatchHub> GetWatchHub()
+            {
+                std::lock_guard<std::mutex> lock(m_WatchHubLock);
+                if(!m_WatchHub)
+                    m_WatchHub = std::make_shared<CVFSWatchHub>();
+
+                return m_WatchHub;
+            }
+
+            std::shared_ptr<CVFSNameTable> m_Names;
+            VFSDir m_Root;
+            bool m_ReadOnly;
+
+            std::unordered_map<uint64_t, VFSNode> m_Handles;
+            uint64_t m_LastHandle;
+            Mutex m_HandleLock;
+
+            Mutex m_MoveLock;   //Serializes moves, see Move.
+            StructureMutex m_StructureLock;     //Shared by changes of child lists, exclusive while Snapshot captures them.
+
+            std::shared_ptr<CVFSExecutor> m_Executor;
+            std::mutex m_ExecutorLock;
+
+            size_t m_Tasks;     //Queued and running tasks of SubmitTask.
+            std::mutex m_TaskLock;
+            std::condition_variable m_TasksDone;
+
+            std::shared_ptr<CVFSWatchHub> m_WatchHub;
+            std::mutex m_WatchHubLock;
+
+            std::map<std::string, std::vector<SPendingAppend>> m_PendingAppends;
+            std::mutex m_PendingLock;
+    };
+
+    /**
+     * @brief File reader and writer.
+     */
+    template<class Policy>
+    class CBasicVFSFileStream
+    {
+        public:
+            CBasicVFSFileStream(typename CBasicVFS<Policy>::VFSFile file, FileMode mode) : m_File(file), m_Mode(mode), m_CurPos(0), m_BufferSize(0)
+            {
+                //Only truncates files, which are opened for writing.
+                if((mode & FileMode::WRITE) == FileMode::WRITE && (mode & FileMode::APPEND) != FileMode::APPEND)
+                    m_File->Clear();
+            }
+
+            /**
+             * @brief Writes a line to the file.
+             * 
+             * @param Line: Line to write.
+             * 
+             * @return Returns the size of written bytes.
+             */
+            size_t WriteLine(const std::string &Line)
+            {
+                char c = '\n';
+                size_t Ret = Write(Line.data(), Line.size());
+                Ret += Write(&c, sizeof(c));
+
+                return Ret;
+            }
+
+            /**
+             * @brief Writes a string to the file.
+             * 
+             * @param Str: String to write.
+             * 
+             * @return Returns the size of written bytes.
+             */
+            size_t Write(const std::string &Str)
+            {
+                return Write(Str.data(), Str.size());
+            }
+
+            /**
+             * @brief Writes data to the file.
+             * 
+             * @param Data: Data to be written
+             * @param Size: Data Size;
+             * 
+             * @return Returns the size of written bytes.
+             */
+            inline size_t Write(const char *Data, size_t Size)
+            {
+                if((m_Mode & FileMode::WRITE) == FileMode::WRITE)
+                {
+                    if(m_BufferSize == 0)
+                        return WriteFile(Data, Size);
+
+                    if(m_Buffer.size() + Size > m_BufferSize)
+                        Flush();
+
+                    //Writes which don't fit into the buffer go straight to the file.
+                    if(Size >= m_BufferSize)
+                        return WriteFile(Data, Size);
+
+                    m_Buffer.append(Data, Size);
+                    return Size;
+                }
+
+                return 0;
+            }
+
+            /**
+             * @brief Enables a write buffer, which collects small writes and writes them to the file with one lock acquisition.
+             * The buffer is written to the file, if it is full, on Flush, before the stream reads, seeks, truncates or takes the data and if the stream is destroyed.
+             * Other streams of the file only see the buffered data after it is written.
+             * 
+             * @param Size: Size of the buffer, 0 disables the buffer. Writes the current content of the buffer.
+             */
+            void SetWriteBuffer(size_t Size)
+            {
+                Flush();
+                m_BufferSize = Size;
+                m_Buffer.shrink_to_fit();
+                m_Buffer.reserve(Size);
+            }
+
+            /**
+             * @brief Writes the content of the write buffer to the file.
+             */
+            void Flush()
+            {
+                if(!m_Buffer.empty())
+                {
+                    WriteFile(m_Buffer.data(), m_Buffer.size());
+                    m_Buffer.clear();
+                }
+            }
+
+            /**
+             * @brief Writes a string to the file. A large string becomes file storage without a copy.
+             * 
+             * @param Str: String to write, it is moved from only if it was written.
+             * 
+             * @return Returns the size of written bytes.
+             */
+            size_t Write(std::string &&Str)
+            {
+                Flush();
+                if((m_Mode & FileMode::WRITE) == FileMode::WRITE)
+                    return m_File->Write(std::move(Str));
+
+                return 0;
+            }
+
+            /**
+             * @brief Writes a vector to the file. A large vector becomes file storage without a copy.
+             * 
+             * @param Buf: Vector to write, it is moved from only if it was written.
+             * 
+             * @return Returns the size of written bytes.
+             */
+            size_t Write(std::vector<char> &&Buf)
+            {
+                Flush();
+                if((m_Mode & FileMode::WRITE) == FileMode::WRITE)
+                    return m_File->Write(std::move(Buf));
+
+                return 0;
+            }
+
+            /**
+             * @brief Writes memory of the caller to the file. Large buffers become file storage without a copy.
+             * 
+             * @param Data: Memory to take over. The stream owns it from now on, even if nothing was written.
+             * @param Size: Size of the memory.
+             * @param Del: Called with Data, once the memory isn't needed anymore.
+             * 
+             * @return Returns the size of written bytes.
+             */
+            template<class Deleter>
+            size_t Write(char *Data, size_t Size, Deleter Del)
+            {
+                Flush();
+                if((m_Mode & FileMode::WRITE) == FileMode::WRITE)
+                    return m_File->Write(Data, Size, std::move(Del));
+
+                Del(Data);
+                return 0;
+            }
+
+            /**
+             * @brief Reads a line of the file.
+             * 
+             * @return Returns the Line.
+             */
+            std::string ReadLine()
+            {
+                std::string Ret;
+                char c;
+                while (Read(&c, sizeof(c)) != 0)
+                {
+                    if(c == '\n')
+                        break;
+
+                    Ret += c;
+                }
+
+                return Ret;
+            }
+
+            /**
+             * @brief Reads the whole file into a string
+             * 
+             * @return Returns the file content as string.
+             */
+            std::string Read()
+            {
+                std::string Ret;
+                Ret.resize(Size());
+                Read(&Ret[0], Ret.size());
+
+                return Ret;
+            }
+
+            /**
+             * @brief Reads data of the file.
+             * 
+             * @param Buf: Buffer to fill.
+             * @param Size: Buffer Size;
+             * 
+             * @return Returns the size of readed bytes.
+             */
+            inline size_t Read(char *Buf, size_t Size)
+            {
+                Flush();
+                if(((m_Mode & FileMode::READ) == FileMode::READ) && this->Size() != 0)
+                {
+                    size_t Ret = m_File->Read(Buf, Size, m_CurPos);
+                    m_CurPos += Ret;
+                    return Ret;
+                }
 
-                        //Sorts the data ascending.
-                        for (Pos = 0; Pos < m_Childs.size(); Pos++)
-                        {
-                            if(Child->Name() < m_Childs[Pos]->Name())
-                                break;
-                        }
-                        
-                        m_Childs.insert(m_Childs.begin() + Pos, Child);
-                    }
+                return 0;
+            }
 
-                    std::vector<VFSNode> m_Childs;
-            };
+            /**
+             * @brief Allocates storage, so the file can grow up to the given size without allocations while writing.
+             * Unused storage is released by Truncate.
+             * 
+             * @param Bytes: Expected size of the file.
+             * 
+             * @throw Throws a CVFSException, if the system is out of memory.
+             */
+            void Reserve(size_t Bytes)
+            {
+                if((m_Mode & FileMode::WRITE) == FileMode::WRITE)
+                    m_File->Reserve(Bytes);
+            }
 
             /**
-             * @brief Splits into a list of names.
+             * @brief Caps the size of the file, only the latest data is kept. See CVFSFile::SetCapacity.
+             * The cursor stays at its offset, if old data is dropped.
              * 
-             * @param Path: Path to split.
+             * @param Bytes: Capacity of the file, 0 removes the cap.
+             */
+            void SetCapacity(size_t Bytes)
+            {
+                Flush();
+                if((m_Mode & FileMode::WRITE) == FileMode::WRITE)
+                {
+                    m_File->SetCapacity(Bytes);
+                    m_CurPos = std::min(m_CurPos, m_File->Size());
+                }
+            }
+
+            /**
+             * @brief Cuts the file to the given size or extends it with zeros. Releases reserved and unused storage of the file.
              * 
-             * @return Returns the path as list.
+             * @param Size: New size of the file.
              */
-            std::vector<std::string> SplitPath(const std::string &Path)
+            void Truncate(size_t Size)
             {
-                size_t Pos = 0;
-                std::vector<std::string> Ret;
+                Flush();
+                if((m_Mode & FileMode::WRITE) == FileMode::WRITE)
+                {
+                    m_File->Truncate(Size);
+                    m_CurPos = std::min(m_CurPos, Size);
+                }
+            }
 
-                //Ignores the first '/' if it exitst.
-                if(!Path.empty() && Path[0] == '/')
-                    Pos++;
+            /**
+             * @brief Moves the whole content out of the file and leaves it empty. Data which was written with Write(std::string&&) or
+             * Write(std::vector<char>&&) is handed back without a copy, if it is the only data of the file and isn't shared with a copy or snapshot.
+             * 
+             * @return Returns the content as std::string or std::vector<char>. Returns an empty buffer, if the stream isn't opened for reading and writing.
+             */
+            template<class Buffer = std::string>
+            Buffer Take()
+            {
+                Flush();
+                m_CurPos = 0;
+                if((m_Mode & FileMode::RW) == FileMode::RW)
+                    return m_File->template Take<Buffer>();
 
-                while (Pos != std::string::npos)
+                return Buffer();
+            }
+
+            /**
+             * @brief Sets the cursor position inside the file.
+             * 
+             * @param cur: Either BEG, CUR or END
+             * @param Bytes: Bytes to seek.
+             */
+            inline void Seek(Cursor cur, int64_t Bytes)
+            {
+                Flush();
+                if(Size() == 0)
+                    return;
+
+                switch (cur)
                 {
-                    size_t Start = Pos;
-                    Pos = Path.find('/', Start);
+                    case Cursor::BEG:
+                    {
+                        m_CurPos = (size_t)Bytes > Size() ? Size() : Bytes;
+                    }break;
 
-                    std::string Dir = Path.substr(Start, Pos - Start);
-                    
-                    if(!Dir.empty())
-                        Ret.push_back(Dir);
+                    case Cursor::CUR:
+                    {
+                        size_t NewPos = m_CurPos + Bytes;
+                        m_CurPos = NewPos > Size() ? Size() : NewPos;
+                    }break;
 
-                    if(Pos != std::string::npos)
-                        Pos++;
+                    case Cursor::END:
+                    {
+                        size_t NewPos = Size() + Bytes;
+                        m_CurPos = NewPos > Size() ? Size() : NewPos;
+                    }break;
                 }
-                
-                return Ret;
             }
 
             /**
-             * @return Returns a path without the last child e.g Path: /test/test.txt -> ret: /test
+             * @return Returns the current cursor position inside the file.
              */
-            std::string ExtractPath(const std::string &Path)
+            inline size_t Tell() const
             {
-                size_t Pos = Path.find_last_of("/");
-                if(Pos == Path.length() - 1)
-                    Pos = Path.find_last_of("/", Pos - 1);
+                return m_CurPos;
+            }
 
-                return Path.substr(0, Pos);
+            /**
+             * @return Returns the file size, including the content of the write buffer.
+             */
+            inline size_t Size() const
+            {
+                return m_File->Size() + m_Buffer.size();
             }
 
             /**
-             * @return Returns the name of the last child
+             * @return Returns true if the end of the file is reached.
              */
-            std::string ExtractName(const std::string &Path)
+            inline bool IsEOF() const
             {
-                size_t End = std::string::npos;
-                size_t Pos = Path.find_last_of("/");
-                if(Pos == Path.length() - 1)
+                return m_CurPos >= Size();
+            }
+
+            /**
+             * @return Returns the file name.
+             */
+            inline std::string Name() const
+            {
+                return m_File->Name();
+            }
+
+            virtual ~CBasicVFSFileStream() 
+            {
+                try
                 {
-                    End = Pos - 1;
-                    Pos = Path.find_last_of("/", Pos - 1);
+                    Flush();
+                }
+                catch(...)
+                {
+                    //A destructor can't report the error, call Flush to get it.
                 }
 
-                return Path.substr(Pos + 1, End - Pos);
+                if((m_Mode & FileMode::WRITE) == FileMode::WRITE)
+                    m_File->CloseWrite();
+            }
+        private:
+            /**
+             * @brief Writes to the file, without its lock if the stream is opened with FileMode::CONCURRENT_APPEND.
+             */
+            size_t WriteFile(const char *Data, size_t Size)
+            {
+                if((m_Mode & FileMode::CONCURRENT_APPEND) == FileMode::CONCURRENT_APPEND)
+                    return m_File->AppendConcurrent(Data, Size);
+
+                return m_File->Write(Data, Size);
             }
 
+            typename CBasicVFS<Policy>::VFSFile m_File;
+            FileMode m_Mode;
+
+            size_t m_CurPos;
+
+            std::string m_Buffer;   //Pending writes, see SetWriteBuffer.
+            size_t m_BufferSize;
+    };
+
+    /**
+     * @brief Iterates lazily over the content of a directory sorted by name, see CVFS::ListCursor.
+     * 
+     * The cursor only remembers the name of the last fetched node and seeks from there with a binary search on each fetch,
+     * so it stays valid while nodes are added or removed. Nodes which are added behind the cursor are returned, nodes before it are skipped.
+     */
+    template<class Policy>
+    class CBasicVFSListCursor
+    {
+        public:
+            using VFSNode = typename CBasicVFS<Policy>::VFSNode;
+
+            CBasicVFSListCursor(typename CBasicVFS<Policy>::VFSDir Dir, const std::string &Prefix, const std::string &StartAfter) : m_Dir(Dir), m_Prefix(Prefix), m_Position(StartAfter), m_BatchPos(0) {}
+
             /**
-             * @brief Fills in padding bytes inside the file.
+             * @return Returns the next node or null if there are no more nodes.
              */
-            void FillSpace(CVFSFile *file, size_t Count)
+            VFSNode Next()
             {
-                for (size_t i = 0; i < Count; i++)
+                //Fetches small batches, so the directory isn't locked for each node.
+                const size_t BATCH_SIZE = 64;
+                if(m_BatchPos == m_Batch.size())
                 {
-                    char c = 0;
-                    file->Write(&c, sizeof(c));
+                    m_Batch.clear();
+                    m_BatchPos = 0;
+                    Fetch(BATCH_SIZE, m_Batch);
+
+                    if(m_Batch.empty())
+                        return nullptr;
                 }
+
+                return std::move(m_Batch[m_BatchPos++]);
             }
-            
-            void SerializeNode(CVFSFile *file, CVFSNode *Node)
+
+            /**
+             * @param Limit: Maximum count of nodes.
+             * 
+             * @return Returns the next nodes. The list is empty if there are no more nodes.
+             */
+            std::vector<VFSNode> Next(size_t Limit)
             {
-                size_t NodeSize = NODE_IDENTIFIER.size() + sizeof(int) + (int)Node->m_Name.size() + sizeof(Node->m_IsDir) + sizeof(Node->m_Created) + sizeof(Node->m_Accessed);
-                file->Write(NODE_IDENTIFIER.data(), NODE_IDENTIFIER.size());
+                std::vector<VFSNode> Ret;
 
-                //Writes all base node informations.
-                int NameSize = Node->m_Name.size();
-                file->Write((char*)&NameSize, sizeof(int));
-                file->Write(Node->m_Name.data(), NameSize);
-                file->Write((char*)&Node->m_IsDir, sizeof(Node->m_IsDir));
-                file->Write((char*)&Node->m_Created, sizeof(Node->m_Created));
-                file->Write((char*)&Node->m_Accessed, sizeof(Node->m_Accessed));
+                //Nodes which are already fetched by Next() come first.
+                for (; m_BatchPos < m_Batch.size() && Ret.size() < Limit; m_BatchPos++)
+                    Ret.push_back(std::move(m_Batch[m_BatchPos]));
 
-                if(Node->IsDir())
-                {
-                    auto Dir = static_cast<CVFSDir*>(Node);
-                    auto Childs = Dir->GetChilds();
+                if(Ret.size() < Limit)
+                    Fetch(Limit - Ret.size(), Ret);
 
-                    //Adds the count of entries.
-                    uint64_t EntryCount = Childs.size();
-                    file->Write((char*)&EntryCount, sizeof(EntryCount));
+                return Ret;
+            }
 
-                    int FillSize = DISK_CHUNK_SIZE - (NodeSize + sizeof(uint64_t));
-                    FillSpace(file, FillSize);
-                    for (auto e : Childs)
-                        SerializeNode(file, e.get());
-                }
-                else
-                {
-                    auto NodeFile = static_cast<CVFSFile*>(Node);
+        private:
+            void Fetch(size_t Limit, std::vector<VFSNode> &Nodes)
+            {
+                std::string Last;
+                m_Dir->GetChilds(m_Position, m_Prefix, Limit, Nodes, Last);
+                if(!Last.empty())
+                    m_Position = std::move(Last);
+            }
 
-                    time_t mtime = NodeFile->Modified();
-                    file->Write((char*)&mtime, sizeof(mtime));
+            typename CBasicVFS<Policy>::VFSDir m_Dir;
+            std::string m_Prefix;
+            std::string m_Position; //Name of the last fetched node.
 
-                    uint64_t Size = NodeFile->Size();
-                    file->Write((char*)&Size, sizeof(Size));
+            std::vector<VFSNode> m_Batch;
+            size_t m_BatchPos;
+    };
 
-                    NodeSize += sizeof(mtime) + sizeof(Size);
+    template<class Policy>
+    inline typename CBasicVFS<Policy>::VFSFileStream CBasicVFS<Policy>::Open(const std::string &Path, FileMode mode, size_t Reserve)
+    {
+        VFS_MEASURE(VFSOp::OPEN);
+        VFSFileStream ret;
+        auto file = OpenFile(Path, mode);
+        if(file)
+            ret = OpenStream(file, mode, Reserve);
 
-                    //If the data fits into the chunk, write it into the current chunk.
-                    int FillSize = DISK_CHUNK_SIZE - (NodeSize > DISK_CHUNK_SIZE ? (NodeSize - DISK_CHUNK_SIZE) : NodeSize);
-                    if(NodeFile->Size() <= FillSize)
-                    {
-                        file->Write(NodeFile->m_Data[0]->Data, NodeFile->m_Data[0]->Filled);
-                        FillSize -= NodeFile->Size();
-                    }
+        return ret;
+    }
 
-                    FillSpace(file, FillSize);
-                    if(NodeFile->Size() > FillSize)
-                    {
-                        FillSize = DISK_CHUNK_SIZE - (NodeFile->Size() % DISK_CHUNK_SIZE);
+    template<class Policy>
+    inline std::future<std::string> CBasicVFS<Policy>::AsyncRead(const std::string &Path)
+    {
+        static_assert(Policy::THREAD_SAFE, "The async api needs a thread safe policy.");
+        return SubmitTask([this, Path]() 
+        { 
+            return Open(Path, FileMode::READ)->Read(); 
+        });
+    }
 
-                        for (auto e : NodeFile->m_Data)
-                        {
-                            if(e->Filled == 0)
-                                break;
+    template<class Policy>
+    inline std::future<size_t> CBasicVFS<Policy>::AsyncWrite(const std::string &Path, std::string Data, FileMode mode)
+    {
+        static_assert(Policy::THREAD_SAFE, "The async api needs a thread safe policy.");
+        if((mode & FileMode::APPEND) == FileMode::APPEND)
+        {
+            std::promise<size_t> Promise;
+            auto Future = Promise.get_future();
+            bool Schedule = false;
 
-                            file->Write(e->Data, e->Filled);
-                        }
+            {
+                std::lock_guard<std::mutex> lock(m_PendingLock);
+                auto &Pending = m_PendingAppends[Path];
+                Schedule = Pending.empty(); //Only the first append schedules a flush.
+                Pending.push_back({std::move(Data), std::move(Promise)});
+            }
 
-                        if(FillSize < DISK_CHUNK_SIZE)
-                            FillSpace(file, FillSize);
-                    }
-                }
+            if(Schedule)
+                SubmitTask([this, Path]() { FlushAppends(Path); });
+
+            return Future;
+        }
+
+        auto Buf = std::make_shared<std::string>(std::move(Data));
+        return SubmitTask([this, Path, Buf, mode]() 
+        {
+            auto fs = Open(Path, mode | FileMode::WRITE);
+            if(!fs)
+                throw CVFSException("Can't create file. Parent directory doesn't exists.", VFSError::CANT_CREATE_FILE);
+
+            return fs->Write(std::move(*Buf));
+        });
+    }
+#ifdef CVFS_HAS_SHARED_MEMORY
+    /**
+     * @brief Typed offset of an object inside a shared memory segment.
+     * Every process maps the segment at another address, so the segment stores offsets from its start instead of pointers.
+     */
+    template<class T>
+    struct SShmPtr
+    {
+        uint64_t Offset = 0;
+
+        explicit operator bool() const
+        {
+            return Offset != 0;
+        }
+    };
+
+    /**
+     * @brief Node inside a shared memory segment. Directories store their childs sorted by name, files store their data in one block.
+     */
+    struct SShmNode
+    {
+        SShmPtr<char> Name;
+        uint32_t NameLen;
+        bool IsDir;
+
+        time_t Created;
+        time_t Accessed;
+        time_t Modified;
+
+        SShmPtr<SShmPtr<SShmNode>> Childs;
+        uint64_t ChildCount;
+        uint64_t ChildCapacity;
+
+        SShmPtr<char> Data;
+        uint64_t Size;
+        uint64_t Capacity;
+    };
+
+    /**
+     * @brief Mutex which is shared between processes. If a process dies while it holds the lock, the data it guards may be
+     * half changed. The mutex isn't made consistent then, so it can't be locked anymore and every lock throws.
+     */
+    class CVFSSharedMutex
+    {
+        public:
+            CVFSSharedMutex()
+            {
+                pthread_mutexattr_t Attr;
+                pthread_mutexattr_init(&Attr);
+                pthread_mutexattr_setpshared(&Attr, PTHREAD_PROCESS_SHARED);
+                pthread_mutexattr_setrobust(&Attr, PTHREAD_MUTEX_ROBUST);
+                pthread_mutex_init(&m_Mutex, &Attr);
+                pthread_mutexattr_destroy(&Attr);
             }
 
-            VFSNode DeserializeNode(const std::vector<char> &Data, size_t &Pos)
+            CVFSSharedMutex(const CVFSSharedMutex&) = delete;
+            CVFSSharedMutex &operator=(const CVFSSharedMutex&) = delete;
+
+            void lock()
             {
-                std::string Identifier(NODE_IDENTIFIER.size(), '\0');
-                ReadVector(Data, &Identifier[0], Identifier.size(), Pos);
-                if(Identifier != NODE_IDENTIFIER)
-                    throw CVFSException("Invalied node identifier!", VFSError::CANT_CREATE_FILESYSTEM);
+                int Ret = pthread_mutex_lock(&m_Mutex);
+                if(Ret == EOWNERDEAD || Ret == ENOTRECOVERABLE)
+                {
+                    //Unlocking without pthread_mutex_consistent marks the mutex as not recoverable for all processes.
+                    if(Ret == EOWNERDEAD)
+                        pthread_mutex_unlock(&m_Mutex);
 
-                int NameSize = 0;
-                ReadVector(Data, (char*)&NameSize, sizeof(NameSize), Pos); 
+                    throw CVFSException("Can't lock the shared filesystem. A process died while it used the filesystem, it may be damaged.", VFSError::CANT_OPEN_FILE);
+                }
+                else if(Ret != 0)
+                    throw CVFSException("Can't lock the shared filesystem.", VFSError::CANT_OPEN_FILE);
+            }
 
-                std::string Name(NameSize, '\0');
-                ReadVector(Data, &Name[0], Name.size(), Pos);
+            void unlock()
+            {
+                pthread_mutex_unlock(&m_Mutex);
+            }
 
-                bool IsDir;
-                ReadVector(Data, (char*)&IsDir, sizeof(IsDir), Pos); 
+        private:
+            pthread_mutex_t m_Mutex;
+    };
 
-                time_t Created;
-                time_t Accessed;
-                ReadVector(Data, (char*)&Created, sizeof(Created), Pos); 
-                ReadVector(Data, (char*)&Accessed, sizeof(Accessed), Pos); 
+    /**
+     * @brief Filesystem which lives inside a POSIX shared memory segment.
+     * 
+     * All processes which open a segment with the same name work on the same tree and the same file data.
+     * The segment has a fixed size and is never moved, so all nodes and data are addressed by offsets from the start of the segment.
+     * All operations are serialized by one process shared mutex inside the segment. Access() hands the file data to a callback
+     * without copying it.
+     */
+    class CSharedVFS
+    {
+        public:
+            /**
+             * @brief Opens the shared memory segment with the given name or creates it, if it doesn't exist.
+             * 
+             * @param Name: Name of the segment, e.g. "/my_vfs".
+             * @param Size: Size of a new segment. An existing segment keeps its size.
+             * 
+             * @throw Throws a CVFSException, if the segment can't be opened or created.
+             */
+            CSharedVFS(const std::string &Name, size_t Size = 64 * 1024 * 1024) : m_Base(nullptr), m_Size(Size)
+            {
+                if(Size < MIN_SIZE)
+                    throw CVFSException("Can't create shared filesystem. Size is too small.", VFSError::CANT_CREATE_FILESYSTEM);
 
-                if(IsDir)
+                int Fd = shm_open(Name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+                bool Created = Fd != -1;
+                if(!Created)
                 {
-                    auto Dir = VFSDir(new CVFSDir(Name));
-                    Dir->m_Created = Created;
-                    Dir->m_Accessed = Accessed;
+                    if(errno == EEXIST)
+                        Fd = shm_open(Name.c_str(), O_RDWR, 0600);
 
-                    uint64_t Entries = 0;
-                    ReadVector(Data, (char*)&Entries, sizeof(Entries), Pos); 
+                    if(Fd == -1)
+                        throw CVFSException("Can't open shared memory segment: " + Name, VFSError::CANT_CREATE_FILESYSTEM);
 
-                    size_t NodeSize = NODE_IDENTIFIER.size() + sizeof(int) + (int)Dir->m_Name.size() + sizeof(Dir->m_IsDir) + sizeof(Dir->m_Created) + sizeof(Dir->m_Accessed) + sizeof(uint64_t);
+                    //The creator may not have set the size yet.
+                    struct stat St = {};
+                    for (int i = 0; i < WAIT_TRIES && (fstat(Fd, &St) != 0 || (size_t)St.st_size < MIN_SIZE); i++)
+                        std::this_thread::sleep_for(std::chrono::milliseconds(1));
 
-                    //Skips the Padding
-                    Pos += DISK_CHUNK_SIZE - NodeSize;
+                    m_Size = St.st_size;
+                }
+                else if(ftruncate(Fd, Size) != 0)
+                {
+                    close(Fd);
+                    shm_unlink(Name.c_str());
+                    throw CVFSException("Can't resize shared memory segment: " + Name, VFSError::CANT_CREATE_FILESYSTEM);
+                }
 
-                    for (size_t i = 0; i < Entries; i++)
-                        Dir->AppendChild(DeserializeNode(Data, Pos));
-            
-                    return Dir;
+                void *Mem = m_Size >= MIN_SIZE ? mmap(nullptr, m_Size, PROT_READ | PROT_WRITE, MAP_SHARED, Fd, 0) : MAP_FAILED;
+                close(Fd);
+
+                if(Mem == MAP_FAILED)
+                {
+                    if(Created)
+                        shm_unlink(Name.c_str());
+
+                    throw CVFSException("Can't map shared memory segment: " + Name, VFSError::CANT_CREATE_FILESYSTEM);
                 }
+
+                m_Base = (char*)Mem;
+                if(Created)
+                    Init();
                 else
                 {
-                    auto File = VFSFile(new CVFSFile(Name));
+                    //Waits until the creator has initialized the segment.
+                    for (int i = 0; i < WAIT_TRIES && Header()->Magic.load(std::memory_order_acquire) != MAGIC; i++)
+                        std::this_thread::sleep_for(std::chrono::milliseconds(1));
 
-                    time_t mtime;
-                    ReadVector(Data, (char*)&mtime, sizeof(mtime), Pos); 
+                    if(Header()->Magic.load(std::memory_order_acquire) != MAGIC || Header()->Version != VERSION)
+                    {
+                        munmap(m_Base, m_Size);
+                        throw CVFSException("Shared memory segment isn't a filesystem: " + Name, VFSError::CANT_CREATE_FILESYSTEM);
+                    }
+                }
+            }
 
-                    File->m_Created = Created;
-                    File->m_Accessed = Accessed;
-                    File->m_Modified = mtime;
+            CSharedVFS(const CSharedVFS&) = delete;
+            CSharedVFS &operator=(const CSharedVFS&) = delete;
 
-                    uint64_t Size;
-                    ReadVector(Data, (char*)&Size, sizeof(Size), Pos);
+            /**
+             * @brief Unmaps the segment. The segment and its content stay alive until Remove is called.
+             */
+            ~CSharedVFS()
+            {
+                munmap(m_Base, m_Size);
+            }
 
-                    size_t NodeSize = NODE_IDENTIFIER.size() + sizeof(int) + (int)File->m_Name.size() + sizeof(File->m_IsDir) + sizeof(File->m_Created) + sizeof(File->m_Accessed) + sizeof(mtime) + sizeof(Size);
-                    int FillSize = DISK_CHUNK_SIZE - (NodeSize > DISK_CHUNK_SIZE ? (NodeSize - DISK_CHUNK_SIZE) : NodeSize);
+            /**
+             * @brief Removes the segment with the given name. Processes which have mapped the segment can still use it.
+             * 
+             * @return Returns false if the segment doesn't exist.
+             */
+            static bool Remove(const std::string &Name)
+            {
+                return shm_unlink(Name.c_str()) == 0;
+            }
 
-                    //Skips the Padding.
-                    if(Size > FillSize)
-                        Pos += FillSize;
+            /**
+             * @brief Create a new directory.
+             * 
+             * @param Path: Path to the directory.
+             * @param Force: Creates all parent dirs, if they aren't exists.
+             * 
+             * @throw Throws a CVFSException, if the dir can't be created or the segment is full.
+             */
+            void CreateDir(const std::string &Path, bool Force = false)
+            {
+                auto Dirs = CVFS::SplitPath(Path);
+                std::lock_guard<CVFSSharedMutex> lock(Header()->Lock);
+                auto CurDir = Get(Header()->Root);
 
-                    std::string Buf(Size, '\0');
-                    ReadVector(Data, &Buf[0], Buf.size(), Pos);
-                    File->Write(Buf.data(), Buf.size());
+                for (size_t i = 0; i < Dirs.size(); i++)
+                {
+                    size_t Pos;
+                    auto node = Search(CurDir, Dirs[i], Pos);
 
-                    //Skips the Padding.
-                    if(Size <= FillSize)
-                        Pos += FillSize - Size;
+                    //Creates the directory either if Force is true or we are at the end of the path.
+                    if(!node && (Force || (i == Dirs.size() - 1)))
+                        CurDir = InsertChild(CurDir, Pos, Dirs[i], true);
+                    else if(!node || !node->IsDir)
+                        throw CVFSException("Can't create directory", VFSError::CANT_CREATE_DIR);
                     else
-                        Pos += DISK_CHUNK_SIZE - (Size % DISK_CHUNK_SIZE);
-
-                    return File;
+                        CurDir = node;
                 }
             }
 
-            VFSDir m_Root;
-    };
+            /**
+             * @return Checks if a given node already exists. Return true if the node exists.
+             */
+            bool NodeExists(const std::string &Path)
+            {
+                std::lock_guard<CVFSSharedMutex> lock(Header()->Lock);
+                return Lookup(Path) != nullptr;
+            }
 
-    /**
-     * @brief File reader and writer.
-     */
-    class CVFSFileStream
-    {
-        public:
-            CVFSFileStream(CVFS::VFSFile file, FileMode mode) : m_File(file), m_Mode(mode), m_CurPos(0)
+            /**
+             * @return Returns true if the node exists and is a directory.
+             */
+            bool IsDir(const std::string &Path)
             {
-                if((mode & FileMode::APPEND) != FileMode::APPEND)
-                    m_File->Clear();
+                std::lock_guard<CVFSSharedMutex> lock(Header()->Lock);
+                auto node = Lookup(Path);
+                return node && node->IsDir;
             }
 
             /**
-             * @brief Writes a line to the file.
-             * 
-             * @param Line: Line to write.
+             * @return Gets the sorted names of the content of a directory.
              * 
-             * @return Returns the size of written bytes.
+             * @throw Throws a CVFSException, if the node doesn't exist or is a file.
              */
-            size_t WriteLine(const std::string &Line)
+            std::vector<std::string> List(const std::string &Path)
             {
-                char c = '\n';
-                size_t Ret = Write(Line.data(), Line.size());
-                Ret += Write(&c, sizeof(c));
+                std::lock_guard<CVFSSharedMutex> lock(Header()->Lock);
+                auto node = Lookup(Path);
+                if(!node)
+                    throw CVFSException("Can't list directory. Node doesn't exists.", VFSError::NODE_DOESNT_EXISTS);
+                else if(!node->IsDir)
+                    throw CVFSException("Can't list directory. Node is a file.", VFSError::NODE_IS_FILE);
+
+                std::vector<std::string> Ret;
+                Ret.reserve(node->ChildCount);
+                auto Childs = Get(node->Childs);
+                for (uint64_t i = 0; i < node->ChildCount; i++)
+                {
+                    auto Child = Get(Childs[i]);
+                    Ret.emplace_back(Get(Child->Name), Child->NameLen);
+                }
 
+                node->Accessed = Now();
                 return Ret;
             }
 
             /**
-             * @brief Writes a string to the file.
-             * 
-             * @param Str: String to write.
+             * @brief Deletes a node and frees its memory.
              * 
-             * @return Returns the size of written bytes.
+             * @throw Throws a CVFSException on error.
              */
-            size_t Write(const std::string &Str)
+            void Delete(const std::string &Path)
             {
-                return Write(Str.data(), Str.size());
+                std::lock_guard<CVFSSharedMutex> lock(Header()->Lock);
+                auto Parent = Lookup(CVFS::ExtractPath(Path));
+                size_t Pos;
+                auto node = Parent && Parent->IsDir && Path != "/" ? Search(Parent, CVFS::ExtractName(Path), Pos) : nullptr;
+                if(!node)
+                    throw CVFSException("Can't delete node. Node doesn't exists.", VFSError::NODE_DOESNT_EXISTS);
+
+                auto Childs = Get(Parent->Childs);
+                memmove(Childs + Pos, Childs + Pos + 1, (Parent->ChildCount - Pos - 1) * sizeof(*Childs));
+                Parent->ChildCount--;
+                Parent->Modified = Now();
+
+                FreeNode(node);
             }
 
             /**
-             * @brief Writes data to the file.
+             * @brief Writes data to a file. The file is created, if it doesn't exist.
              * 
-             * @param Data: Data to be written
-             * @param Size: Data Size;
+             * @param Path: Path of the file.
+             * @param Buf: Data to write.
+             * @param Size: Size of the data.
+             * @param Mode: FileMode::APPEND appends the data, otherwise the data replaces the content of the file.
              * 
-             * @return Returns the size of written bytes.
+             * @throw Throws a CVFSException, if the file can't be created or the segment is full.
              */
-            inline size_t Write(const char *Data, size_t Size)
+            void Write(const std::string &Path, const void *Buf, size_t Size, FileMode Mode = FileMode::WRITE)
             {
-                if((m_Mode & FileMode::WRITE) == FileMode::WRITE)
+                std::lock_guard<CVFSSharedMutex> lock(Header()->Lock);
+                auto Parent = Lookup(CVFS::ExtractPath(Path));
+                std::string Name = CVFS::ExtractName(Path);
+                if(!Parent || !Parent->IsDir || Name.empty())
+                    throw CVFSException("Can't create file. Parent directory doesn't exists.", VFSError::CANT_CREATE_FILE);
+
+                size_t Pos;
+                auto file = Search(Parent, Name, Pos);
+                if(file && file->IsDir)
+                    throw CVFSException("Can't open file. Node is a directory.", VFSError::NODE_IS_DIR);
+
+                uint64_t Offset = file && (Mode & FileMode::APPEND) == FileMode::APPEND ? file->Size : 0;
+                uint64_t Capacity = file ? file->Capacity : 0;
+                SShmPtr<char> Data;
+                if(Offset + Size > Capacity)
                 {
-                    return m_File->Write(Data, Size);
+                    //Grows geometrically, so appends are amortized.
+                    Capacity = std::max<uint64_t>(Offset + Size, Capacity * 2);
+                    Data = New<char>(Capacity);
+                    if(Offset)
+                        memcpy(Get(Data), Get(file->Data), Offset);
                 }
 
-                return 0;
+                if(!file)
+                {
+                    try
+                    {
+                        file = InsertChild(Parent, Pos, Name, false);
+                    }
+                    catch(...)
+                    {
+                        Free(Data);
+                        throw;
+                    }
+                }
+
+                if(Data)
+                {
+                    Free(file->Data);
+                    file->Data = Data;
+                    file->Capacity = Capacity;
+                }
+
+                if(Size)
+                    memcpy(Get(file->Data) + Offset, Buf, Size);
+
+                file->Size = Offset + Size;
+                file->Modified = Now();
             }
 
             /**
-             * @brief Reads a line of the file.
+             * @brief Writes a string to a file. See Write(Path, Buf, Size, Mode).
+             */
+            void Write(const std::string &Path, const std::string &Data, FileMode Mode = FileMode::WRITE)
+            {
+                Write(Path, Data.data(), Data.size(), Mode);
+            }
+
+            /**
+             * @brief Reads data of a file.
              * 
-             * @return Returns the Line.
+             * @param Path: Path of the file.
+             * @param Buf: Buffer which receives the data.
+             * @param Size: Size of the buffer.
+             * @param Offset: Position in the file to read from.
+             * 
+             * @return Returns the count of bytes read.
+             * @throw Throws a CVFSException, if the file doesn't exist.
              */
-            std::string ReadLine()
+            size_t Read(const std::string &Path, void *Buf, size_t Size, uint64_t Offset = 0)
             {
-                std::string Ret;
-                char c;
-                while (Read(&c, sizeof(c)) != 0)
+                size_t Ret = 0;
+                Access(Path, [&](const char *Data, uint64_t FileSize)
                 {
-                    if(c == '\n')
-                        break;
-
-                    Ret += c;
-                }
+                    if(Offset < FileSize)
+                    {
+                        Ret = (size_t)std::min<uint64_t>(Size, FileSize - Offset);
+                        memcpy(Buf, Data + Offset, Ret);
+                    }
+                });
 
                 return Ret;
             }
 
             /**
-             * @brief Reads the whole file into a string
+             * @return Returns the whole content of a file.
              * 
-             * @return Returns the file content as string.
+             * @throw Throws a CVFSException, if the file doesn't exist.
              */
-            std::string Read()
+            std::string Read(const std::string &Path)
             {
                 std::string Ret;
-                Ret.resize(Size());
-                Read(&Ret[0], Ret.size());
+                Access(Path, [&](const char *Data, uint64_t Size)
+                {
+                    Ret.assign(Data, Size);
+                });
 
                 return Ret;
             }
 
             /**
-             * @brief Reads data of the file.
+             * @brief Calls Op(const char *Data, uint64_t Size) with the data of a file, without copying it.
+             * The segment is locked while Op runs, so Op must not call this filesystem.
              * 
-             * @param Buf: Buffer to fill.
-             * @param Size: Buffer Size;
+             * @throw Throws a CVFSException, if the file doesn't exist.
+             */
+            template<class Func>
+            void Access(const std::string &Path, Func &&Op)
+            {
+                std::lock_guard<CVFSSharedMutex> lock(Header()->Lock);
+                auto file = Lookup(Path);
+                if(!file)
+                    throw CVFSException("Can't open file. File doesn't exists.", VFSError::CANT_OPEN_FILE);
+                else if(file->IsDir)
+                    throw CVFSException("Can't open file. Node is a directory.", VFSError::NODE_IS_DIR);
+
+                file->Accessed = Now();
+                Op((const char*)Get(file->Data), file->Size);
+            }
+
+            /**
+             * @return Returns the size of a file.
              * 
-             * @return Returns the size of readed bytes.
+             * @throw Throws a CVFSException, if the file doesn't exist.
              */
-            inline size_t Read(char *Buf, size_t Size)
+            uint64_t FileSize(const std::string &Path)
             {
-                if(((m_Mode & FileMode::READ) == FileMode::READ) && this->Size() != 0)
+                uint64_t Ret = 0;
+                Access(Path, [&](const char*, uint64_t Size)
                 {
-                    size_t Ret = m_File->Read(Buf, Size, m_CurPos);
-                    m_CurPos += Ret;
-                    return Ret;
-                }
+                    Ret = Size;
+                });
 
-                return 0;
+                return Ret;
             }
 
             /**
-             * @brief Sets the cursor position inside the file.
-             * 
-             * @param cur: Either BEG, CUR or END
-             * @param Bytes: Bytes to seek.
+             * @return Returns the size of the segment.
              */
-            inline void Seek(Cursor cur, int64_t Bytes)
+            inline size_t Capacity() const
             {
-                if(Size() == 0)
-                    return;
+                return m_Size;
+            }
 
-                switch (cur)
-                {
-                    case Cursor::BEG:
-                    {
-                        m_CurPos = (size_t)Bytes > Size() ? Size() : Bytes;
-                    }break;
+            /**
+             * @return Returns the count of bytes which were ever handed out by the segment allocator. Freed blocks are reused, but never returned.
+             */
+            size_t Used()
+            {
+                std::lock_guard<CVFSSharedMutex> lock(Header()->Lock);
+                return Header()->Used;
+            }
 
-                    case Cursor::CUR:
-                    {
-                        size_t NewPos = m_CurPos + Bytes;
-                        m_CurPos = NewPos > Size() ? Size() : NewPos;
-                    }break;
+        private:
+            static const uint32_t MAGIC = 0x53465643;   //"CVFS"
+            static const uint32_t VERSION = 1;
+            static const int WAIT_TRIES = 1000;
+            static const size_t MIN_SIZE = 64 * 1024;
+            static const uint64_t BLOCK_HEADER = 16;
+            static const uint32_t MIN_CLASS = 5;
+            static const uint32_t CLASSES = 64;
 
-                    case Cursor::END:
-                    {
-                        size_t NewPos = Size() + Bytes;
-                        m_CurPos = NewPos > Size() ? Size() : NewPos;
-                    }break;
-                }
+            /**
+             * @brief Start of the segment.
+             */
+            struct SHeader
+            {
+                std::atomic<uint32_t> Magic;
+                uint32_t Version;
+                uint64_t Size;
+                CVFSSharedMutex Lock;
+                uint64_t Used;
+                uint64_t Free[CLASSES];     //Free lists of the power of two block sizes.
+                SShmPtr<SShmNode> Root;
+            };
+
+            /**
+             * @brief Is in front of each allocated block.
+             */
+            struct SBlock
+            {
+                uint64_t Class;
+                uint64_t Next;
+            };
+
+            void Init()
+            {
+                auto Head = new (m_Base) SHeader();
+                Head->Version = VERSION;
+                Head->Size = m_Size;
+                Head->Used = (sizeof(SHeader) + 63) & ~(uint64_t)63;
+                memset(Head->Free, 0, sizeof(Head->Free));
+
+                Head->Root = New<SShmNode>(1);
+                InitNode(Get(Head->Root), "/", true);
+                Head->Magic.store(MAGIC, std::memory_order_release);
+            }
+
+            inline SHeader *Header() const
+            {
+                return (SHeader*)m_Base;
+            }
+
+            template<class T>
+            inline T *Get(SShmPtr<T> Ptr) const
+            {
+                return Ptr ? (T*)(m_Base + Ptr.Offset) : nullptr;
+            }
+
+            template<class T>
+            inline SShmPtr<T> PtrOf(T *Obj) const
+            {
+                return SShmPtr<T>{(uint64_t)((char*)Obj - m_Base)};
             }
 
             /**
-             * @return Returns the current cursor position inside the file.
+             * @brief Allocates Count objects inside the segment. Blocks are power of two sized and reused through free lists.
+             * 
+             * @throw Throws a CVFSException, if the segment is full.
              */
-            inline size_t Tell() const
+            template<class T>
+            SShmPtr<T> New(uint64_t Count)
             {
-                return m_CurPos;
+                uint64_t Size = Count * sizeof(T) + BLOCK_HEADER;
+                uint32_t Class = MIN_CLASS;
+                while (Class < CLASSES - 1 && (uint64_t(1) << Class) < Size)
+                    Class++;
+
+                auto Head = Header();
+                uint64_t Offset = Head->Free[Class];
+                if(Offset)
+                    Head->Free[Class] = ((SBlock*)(m_Base + Offset))->Next;
+                else
+                {
+                    uint64_t BlockSize = uint64_t(1) << Class;
+                    if(BlockSize < Size || BlockSize > Head->Size - Head->Used)
+                        throw CVFSException("Shared memory segment is full.", VFSError::OUT_OF_MEM);
+
+                    Offset = Head->Used;
+                    Head->Used += BlockSize;
+                }
+
+                ((SBlock*)(m_Base + Offset))->Class = Class;
+                return SShmPtr<T>{Offset + BLOCK_HEADER};
+            }
+
+            template<class T>
+            void Free(SShmPtr<T> Ptr)
+            {
+                if(!Ptr)
+                    return;
+
+                uint64_t Offset = Ptr.Offset - BLOCK_HEADER;
+                auto Block = (SBlock*)(m_Base + Offset);
+                Block->Next = Header()->Free[Block->Class];
+                Header()->Free[Block->Class] = Offset;
+            }
+
+            void InitNode(SShmNode *node, const std::string &Name, bool IsDir)
+            {
+                *node = SShmNode();
+                node->Name = New<char>(Name.size());
+                memcpy(Get(node->Name), Name.data(), Name.size());
+                node->NameLen = (uint32_t)Name.size();
+                node->IsDir = IsDir;
+                node->Created = node->Accessed = node->Modified = Now();
             }
 
             /**
-             * @return Returns the file size.
+             * @brief Frees a node and all of its childs.
              */
-            inline size_t Size() const
+            void FreeNode(SShmNode *node)
             {
-                return m_File->Size();
+                auto Childs = Get(node->Childs);
+                for (uint64_t i = 0; i < node->ChildCount; i++)
+                    FreeNode(Get(Childs[i]));
+
+                Free(node->Childs);
+                Free(node->Data);
+                Free(node->Name);
+                Free(PtrOf(node));
             }
 
             /**
-             * @return Returns true if the end of the file is reached.
+             * @brief Searches a child by its name.
+             * 
+             * @param Pos: Receives the index of the child or the index where it would be inserted.
+             * 
+             * @return Returns null if the child doesn't exist.
              */
-            inline bool IsEOF() const
+            SShmNode *Search(SShmNode *Dir, const std::string &Name, size_t &Pos) const
             {
-                return m_CurPos >= Size();
+                auto Childs = Get(Dir->Childs);
+                size_t Lo = 0, Hi = Dir->ChildCount;
+                while (Lo < Hi)
+                {
+                    size_t Mid = (Lo + Hi) / 2;
+                    auto Child = Get(Childs[Mid]);
+                    int Cmp = Name.compare(0, std::string::npos, Get(Child->Name), Child->NameLen);
+                    if(Cmp == 0)
+                    {
+                        Pos = Mid;
+                        return Child;
+                    }
+                    else if(Cmp > 0)
+                        Lo = Mid + 1;
+                    else
+                        Hi = Mid;
+                }
+
+                Pos = Lo;
+                return nullptr;
             }
 
             /**
-             * @return Returns the file name.
+             * @brief Creates a new node and inserts it into the sorted childs of a directory.
              */
-            inline std::string Name() const
+            SShmNode *InsertChild(SShmNode *Dir, size_t Pos, const std::string &Name, bool IsDir)
             {
-                return m_File->Name();
+                //Allocates everything first, so a full segment leaves the tree unchanged.
+                SShmPtr<SShmPtr<SShmNode>> Childs;
+                uint64_t Capacity = Dir->ChildCapacity;
+                if(Dir->ChildCount == Capacity)
+                {
+                    Capacity = std::max<uint64_t>(4, Capacity * 2);
+                    Childs = New<SShmPtr<SShmNode>>(Capacity);
+                    if(Dir->ChildCount)
+                        memcpy(Get(Childs), Get(Dir->Childs), Dir->ChildCount * sizeof(SShmPtr<SShmNode>));
+                }
+
+                SShmPtr<SShmNode> Child;
+                try
+                {
+                    Child = New<SShmNode>(1);
+                    InitNode(Get(Child), Name, IsDir);
+                }
+                catch(...)
+                {
+                    Free(Child);
+                    Free(Childs);
+                    throw;
+                }
+
+                if(Childs)
+                {
+                    Free(Dir->Childs);
+                    Dir->Childs = Childs;
+                    Dir->ChildCapacity = Capacity;
+                }
+
+                auto Array = Get(Dir->Childs);
+                memmove(Array + Pos + 1, Array + Pos, (Dir->ChildCount - Pos) * sizeof(*Array));
+                Array[Pos] = Child;
+                Dir->ChildCount++;
+                Dir->Modified = Now();
+                return Get(Child);
             }
 
-            virtual ~CVFSFileStream() {}
-        private:
-            CVFS::VFSFile m_File;
-            FileMode m_Mode;
+            /**
+             * @return Gets the node of a path. Returns null if the node wasn't found.
+             */
+            SShmNode *Lookup(const std::string &Path) const
+            {
+                auto Dirs = CVFS::SplitPath(Path);
+                auto node = Get(Header()->Root);
+                size_t Pos;
 
-            size_t m_CurPos;
-    };
+                for (size_t i = 0; i < Dirs.size() && node; i++)
+                    node = node->IsDir ? Search(node, Dirs[i], Pos) : nullptr;
 
-    inline VFSFileStream CVFS::Open(const std::string &Path, FileMode mode)
-    {
-        VFSFileStream ret;
-        auto node = GetNodeInfo(Path);
-        if(node && !node->IsDir())
-            ret = VFSFileStream(new CVFSFileStream(std::static_pointer_cast<CVFSFile>(node), mode));
-        else if(node && node->IsDir())
-            throw CVFSException("Can't open file. A directory with the given name already exists.", VFSError::CANT_CREATE_FILE);
-        else if((mode & FileMode::WRITE) == FileMode::WRITE)    //Creates a new file.
-        {
-            node = GetNodeInfo(ExtractPath(Path));
-            if(node)
+                return node;
+            }
+
+            static time_t Now()
             {
-                auto file = VFSFile(new CVFSFile(ExtractName(Path)));
-                auto dir = std::static_pointer_cast<CVFSDir>(node);
-                dir->AppendChild(file);
-                ret = VFSFileStream(new CVFSFileStream(file, mode));
+                return std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
             }
-        }
-        else
-            throw CVFSException("Can't open file. File doesn't exists.", VFSError::CANT_OPEN_FILE);
 
-        return ret;
-    }
+            char *m_Base;
+            size_t m_Size;
+    };
+#endif
 } // namespace VFS
 
 
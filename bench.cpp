@@ -0,0 +1,919 @@
+#include <VFS.hpp>
+#include <iostream>
+#include <cstdlib>
+#include <new>
+#include <fstream>
+
+using namespace std;
+
+//Counts all allocations of the process, reported as bytes allocated per operation.
+static atomic<uint64_t> g_AllocBytes(0);
+static atomic<uint64_t> g_AllocCount(0);
+static atomic<int64_t> g_LiveBytes(0);
+
+//Each allocation stores its size in front of the memory, so frees can be subtracted from the live bytes.
+static const size_t HEADER_SIZE = alignof(max_align_t);
+
+void *operator new(size_t Size)
+{
+	g_AllocBytes.fetch_add(Size, memory_order_relaxed);
+	g_AllocCount.fetch_add(1, memory_order_relaxed);
+	g_LiveBytes.fetch_add(Size, memory_order_relaxed);
+
+	char *Ret = (char*)malloc(Size + HEADER_SIZE);
+	if(!Ret)
+		throw bad_alloc();
+
+	*(size_t*)Ret = Size;
+	return Ret + HEADER_SIZE;
+}
+
+void *operator new[](size_t Size)
+{
+	return operator new(Size);
+}
+
+void operator delete(void *Ptr) noexcept
+{
+	if(!Ptr)
+		return;
+
+	char *Mem = (char*)Ptr - HEADER_SIZE;
+	g_LiveBytes.fetch_sub(*(size_t*)Mem, memory_order_relaxed);
+	free(Mem);
+}
+
+void operator delete[](void *Ptr) noexcept
+{
+	operator delete(Ptr);
+}
+
+void operator delete(void *Ptr, size_t) noexcept
+{
+	operator delete(Ptr);
+}
+
+void operator delete[](void *Ptr, size_t) noexcept
+{
+	operator delete(Ptr);
+}
+
+struct SResult
+{
+	string Name;
+	string Params;
+	size_t Ops;
+	double OpsPerSec;
+	double P50;
+	double P99;
+	double BytesPerOp;
+	double AllocsPerOp;
+	double RetainedPerOp;
+	double BytesPerSec;
+};
+
+static vector<SResult> g_Results;
+static string g_Filter;
+static double g_Scale = 1.0;
+
+static size_t Scaled(size_t Count)
+{
+	size_t Ret = (size_t)(Count * g_Scale);
+	return Ret > 0 ? Ret : 1;
+}
+
+/**
+ * @brief Runs a benchmark, each call of Op is measured as one operation.
+ *
+ * @param Name: Name of the benchmark.
+ * @param Params: Parameters of the benchmark, shown in the report.
+ * @param Ops: Count of operations.
+ * @param Op: Operation, gets the index of the operation.
+ * @param BytesPerOp: Payload of one operation, used for the throughput.
+ */
+template<class Func>
+static void Run(const string &Name, const string &Params, size_t Ops, Func Op, size_t BytesPerOp = 0)
+{
+	if(!g_Filter.empty() && Name.find(g_Filter) == string::npos)
+		return;
+
+	vector<double> Times;
+	Times.reserve(Ops);
+
+	uint64_t Bytes = g_AllocBytes.load();
+	uint64_t Count = g_AllocCount.load();
+	int64_t Live = g_LiveBytes.load();
+	auto Start = chrono::steady_clock::now();
+
+	for (size_t i = 0; i < Ops; i++)
+	{
+		auto OpStart = chrono::steady_clock::now();
+		Op(i);
+		Times.push_back(chrono::duration<double, nano>(chrono::steady_clock::now() - OpStart).count());
+	}
+
+	double Total = chrono::duration<double>(chrono::steady_clock::now() - Start).count();
+	Bytes = g_AllocBytes.load() - Bytes;
+	Count = g_AllocCount.load() - Count;
+	Live = g_LiveBytes.load() - Live;
+
+	sort(Times.begin(), Times.end());
+
+	SResult Res;
+	Res.Name = Name;
+	Res.Params = Params;
+	Res.Ops = Ops;
+	Res.OpsPerSec = Ops / Total;
+	Res.P50 = Times[Times.size() / 2];
+	Res.P99 = Times[min(Times.size() - 1, (Times.size() * 99) / 100)];
+	Res.BytesPerOp = (double)Bytes / Ops;
+	Res.AllocsPerOp = (double)Count / Ops;
+	Res.RetainedPerOp = (double)Live / Ops;
+	Res.BytesPerSec = (BytesPerOp * Ops) / Total;
+	g_Results.push_back(Res);
+
+	cerr << Name << " " << Params << ": " << (size_t)Res.OpsPerSec << " ops/s" << endl;
+}
+
+static string Path(size_t Depth)
+{
+	string Ret;
+	for (size_t i = 0; i < Depth; i++)
+		Ret += "/d" + to_string(i);
+
+	return Ret;
+}
+
+/**
+ * @brief Creates Dirs directories with Files files each, filled with Size bytes.
+ */
+static void Populate(VFS::CVFS &vfs, const string &Root, size_t Dirs, size_t Files, size_t Size)
+{
+	string Data(Size, 'x');
+	vfs.CreateDir(Root, true);
+	for (size_t i = 0; i < Dirs; i++)
+	{
+		string Dir = Root + "/dir" + to_string(i);
+		vfs.CreateDir(Dir);
+
+		for (size_t j = 0; j < Files; j++)
+			vfs.Open(Dir + "/file" + to_string(j), VFS::FileMode::WRITE)->Write(Data);
+	}
+}
+
+static void BenchCreateDir()
+{
+	for (size_t Count : {Scaled(1000), Scaled(5000)})
+	{
+		VFS::CVFS vfs;
+		Run("create_dir_fanout", "dirs=" + to_string(Count), Count, [&](size_t i)
+		{
+			vfs.CreateDir("/dir" + to_string((i * 7919) % Count));
+		});
+	}
+}
+
+/**
+ * @brief Creates many tiny files, the retained bytes per operation are the memory cost of one file node.
+ */
+static void BenchTinyFiles()
+{
+	size_t Count = Scaled(100000);
+	VFS::CVFS vfs;
+	string Data(20, 'x');
+	for (size_t i = 0; i < Count / 1000 + 1; i++)
+		vfs.CreateDir("/dir" + to_string(i));
+
+	Run("create_tiny_file", "files=" + to_string(Count) + " size=20", Count, [&](size_t i)
+	{
+		vfs.Open("/dir" + to_string(i / 1000) + "/file" + to_string(i % 1000), VFS::FileMode::WRITE)->Write(Data);
+	});
+}
+
+static void BenchLookup()
+{
+	for (size_t Depth : {8, 64})
+	{
+		VFS::CVFS vfs;
+		string Deep = Path(Depth);
+		vfs.CreateDir(Deep, true);
+
+		Run("get_node_info", "depth=" + to_string(Depth), Scaled(100000), [&](size_t)
+		{
+			if(!vfs.GetNodeInfo(Deep))
+				abort();
+		});
+
+		//Resolves a child relative to a handle of the deepest directory.
+		vfs.Open(Deep + "/file", VFS::FileMode::WRITE);
+		uint64_t Handle = vfs.OpenHandle(Deep);
+		Run("stat_at", "depth=" + to_string(Depth), Scaled(100000), [&](size_t)
+		{
+			if(!vfs.StatAt(Handle, "file"))
+				abort();
+		});
+	}
+}
+
+/**
+ * @brief Lists the first page and a prefix of a large directory, compared to a full listing.
+ */
+static void BenchList()
+{
+	size_t Count = Scaled(100000);
+	VFS::CVFS vfs;
+	vfs.CreateDir("/dir");
+	for (size_t i = 0; i < Count; i++)
+		vfs.Open("/dir/" + string(i % 100 == 0 ? "2026-10-" : "file") + to_string(i), VFS::FileMode::WRITE);
+
+	string Params = "files=" + to_string(Count);
+	Run("list", Params, 10, [&](size_t)
+	{
+		vfs.List("/dir");
+	});
+
+	Run("list_range", Params + " limit=100", Scaled(10000), [&](size_t i)
+	{
+		vfs.ListRange("/dir", "file" + to_string(i % Count), 100);
+	});
+
+	Run("list_prefix", Params + " matches=" + to_string(Count / 100), Scaled(1000), [&](size_t)
+	{
+		vfs.ListPrefix("/dir", "2026-10-");
+	});
+}
+
+static void BenchWriteRead()
+{
+	struct SCase
+	{
+		const char *Name;
+		size_t Size;
+		size_t Ops;
+	};
+
+	for (auto &&e : {SCase{"small", 64, Scaled(200000)}, SCase{"large", 1 << 20, Scaled(256)}})
+	{
+		VFS::CVFS vfs;
+		string Data(e.Size, 'x');
+		auto fs = vfs.Open("/write", VFS::FileMode::RW);
+
+		Run(string("write_") + e.Name, "size=" + to_string(e.Size), e.Ops, [&](size_t)
+		{
+			fs->Write(Data);
+		}, e.Size);
+
+		//The read benchmark gets its own file, so it doesn't depend on the write benchmark.
+		fs = vfs.Open("/read", VFS::FileMode::RW);
+		for (size_t i = 0; i < e.Ops; i++)
+			fs->Write(Data);
+
+		vector<char> Buf(e.Size);
+		fs->Seek(VFS::Cursor::BEG, 0);
+		Run(string("read_") + e.Name, "size=" + to_string(e.Size), e.Ops, [&](size_t)
+		{
+			if(fs->Read(Buf.data(), Buf.size()) != Buf.size())
+				abort();
+		}, e.Size);
+	}
+
+	//The same small writes, collected by the write buffer of the stream.
+	{
+		VFS::CVFS vfs;
+		string Data(64, 'x');
+		auto fs = vfs.Open("/buffered", VFS::FileMode::WRITE);
+		fs->SetWriteBuffer(64 * 1024);
+
+		Run("write_small_buffered", "size=64 buffer=65536", Scaled(200000), [&](size_t)
+		{
+			fs->Write(Data);
+		}, 64);
+	}
+
+	VFS::CVFS vfs;
+	auto fs = vfs.Open("/lines", VFS::FileMode::RW);
+	size_t Lines = Scaled(100000);
+	for (size_t i = 0; i < Lines; i++)
+		fs->WriteLine("line " + to_string(i) + " of the benchmark file");
+
+	fs->Seek(VFS::Cursor::BEG, 0);
+	Run("read_line", "lines=" + to_string(Lines), Lines, [&](size_t)
+	{
+		fs->ReadLine();
+	});
+}
+
+/**
+ * @brief Appends small records to one file on several threads. append_locked takes the lock of the file for each write,
+ * append_concurrent reserves ranges without it (FileMode::CONCURRENT_APPEND). One operation are all appends of all threads.
+ */
+static void BenchConcurrentAppend()
+{
+	const size_t SIZE = 64;
+	size_t Appends = Scaled(200000);
+	string Data(SIZE, 'x');
+
+	for (size_t Threads : {1, 4})
+	{
+		for (auto Mode : {VFS::FileMode::WRITE | VFS::FileMode::APPEND, VFS::FileMode::WRITE | VFS::FileMode::CONCURRENT_APPEND})
+		{
+			bool Concurrent = Mode == (VFS::FileMode::WRITE | VFS::FileMode::CONCURRENT_APPEND);
+			VFS::CVFS vfs;
+			vfs.Open("/log", VFS::FileMode::WRITE);
+
+			size_t Ran = 0;
+			Run(Concurrent ? "append_concurrent" : "append_locked", "threads=" + to_string(Threads) + " size=" + to_string(SIZE) + " appends=" + to_string(Appends), 5, [&](size_t)
+			{
+				Ran++;
+				vector<thread> Writers;
+				for (size_t t = 0; t < Threads; t++)
+				{
+					Writers.emplace_back([&]()
+					{
+						auto fs = vfs.Open("/log", Mode);
+						for (size_t i = 0; i < Appends / Threads; i++)
+							fs->Write(Data);
+					});
+				}
+
+				for (auto &&e : Writers)
+					e.join();
+			}, Appends * SIZE);
+
+			if(vfs.Open("/log", VFS::FileMode::READ)->Size() != Ran * (Appends / Threads) * Threads * SIZE)
+				abort();
+		}
+	}
+}
+
+/**
+ * @brief Appends small records to a capped file, which was filled before. Compared with write_small the file doesn't grow
+ * and the writes reuse the chunks of the ring, so allocs/op are 0.
+ */
+static void BenchCapped()
+{
+	const size_t CAPACITY = 1 << 20;
+	VFS::CVFS vfs;
+	string Data(64, 'x');
+	auto fs = vfs.Open("/trace", VFS::FileMode::WRITE | VFS::FileMode::APPEND);
+	fs->SetCapacity(CAPACITY);
+	for (size_t i = 0; i < 2 * CAPACITY / Data.size(); i++)
+		fs->Write(Data);
+
+	Run("write_capped", "size=64 capacity=" + to_string(CAPACITY), Scaled(200000), [&](size_t)
+	{
+		fs->Write(Data);
+	}, 64);
+
+	if(fs->Size() < CAPACITY || fs->Size() >= CAPACITY + CAPACITY / 8)
+		abort();
+}
+
+/**
+ * @brief Hands filled buffers over to a file, compared with write_large this shows the cost of the copy.
+ */
+static void BenchAdopt()
+{
+	VFS::CVFS vfs;
+	size_t Ops = Scaled(256);
+	vector<vector<char>> Buffers(Ops, vector<char>(1 << 20, 'x'));
+	auto fs = vfs.Open("/adopt", VFS::FileMode::RW);
+
+	Run("write_adopt", "size=" + to_string(1 << 20), Ops, [&](size_t i)
+	{
+		fs->Write(std::move(Buffers[i]));
+	}, 1 << 20);
+}
+
+/**
+ * @brief Writes 1 MiB files in 4 KiB blocks, with and without reserving the size when the file is opened.
+ */
+static void BenchReserve()
+{
+	string Data(4096, 'x');
+	for (size_t Reserve : {(size_t)0, (size_t)1 << 20})
+	{
+		VFS::CVFS vfs;
+		Run("write_file", "size=1048576 reserve=" + to_string(Reserve), Scaled(500), [&](size_t i)
+		{
+			auto fs = vfs.Open("/file" + to_string(i), VFS::FileMode::WRITE, Reserve);
+			for (size_t j = 0; j < 256; j++)
+				fs->Write(Data.data(), Data.size());
+		}, 1 << 20);
+	}
+}
+
+static void BenchCopy()
+{
+	for (size_t Dirs : {Scaled(10), Scaled(100)})
+	{
+		VFS::CVFS vfs;
+		Populate(vfs, "/src", Dirs, 100, 4096);
+
+		Run("copy_subtree", "files=" + to_string(Dirs * 100) + " size=4096", 10, [&](size_t i)
+		{
+			vfs.Copy("/src", "/dst" + to_string(i));
+		});
+	}
+
+	//Large tree of small files, the copy is dominated by cloning the nodes.
+	VFS::CVFS vfs;
+	size_t Dirs = Scaled(1000);
+	Populate(vfs, "/src", Dirs, 100, 64);
+
+	Run("copy_subtree", "files=" + to_string(Dirs * 100) + " size=64", 5, [&](size_t i)
+	{
+		vfs.Copy("/src", "/dst" + to_string(i));
+	});
+}
+
+/**
+ * @brief Deletes subtrees, the latency is the time the caller is blocked. The memory is released in the background.
+ */
+static void BenchDelete()
+{
+	VFS::CVFS vfs;
+	size_t Ops = Scaled(20);
+	for (size_t i = 0; i < Ops; i++)
+		Populate(vfs, "/tree" + to_string(i), 10, 100, 4096);
+
+	Run("delete_tree", "files=1000 size=4096", Ops, [&](size_t i)
+	{
+		vfs.Delete("/tree" + to_string(i));
+	});
+
+	vfs.Drain();
+}
+
+/**
+ * @brief Walks a random path of existing nodes from the root.
+ *
+ * @param Seed: State of the random generator of the calling thread.
+ * @param DirsOnly: Stops at directories.
+ */
+static string RandomPath(VFS::CVFS &vfs, uint64_t &Seed, bool DirsOnly)
+{
+	string Ret;
+	for (size_t Depth = 0; Depth < 8; Depth++)
+	{
+		Seed = Seed * 6364136223846793005ULL + 1442695040888963407ULL;
+		auto Childs = vfs.List(Ret.empty() ? "/" : Ret);
+		if(Childs.empty())
+			break;
+
+		auto &Child = Childs[(Seed >> 33) % Childs.size()];
+		if(DirsOnly && !Child->IsDir())
+			break;
+
+		Ret += "/" + Child->Name();
+		if(!Child->IsDir() || (Seed >> 20) % 3 == 0)
+			break;
+	}
+
+	return Ret.empty() ? "/" : Ret;
+}
+
+/**
+ * @brief Counts all nodes below a directory and aborts, if a node is reachable twice or the childs aren't sorted.
+ */
+static size_t CheckTree(VFS::CVFS &vfs, const VFS::VFSNode &Dir, unordered_set<VFS::CVFSNode*> &Seen)
+{
+	size_t Ret = 0;
+	string Last;
+	for (auto &&e : vfs.List(Dir))
+	{
+		string Name = e->Name();
+		if(!Seen.insert(e.get()).second || Name <= Last)
+		{
+			cerr << "move_stress: inconsistent tree at " << Name << endl;
+			abort();
+		}
+
+		Last = Name;
+		Ret += 1 + (e->IsDir() ? CheckTree(vfs, e, Seen) : 0);
+	}
+
+	return Ret;
+}
+
+/**
+ * @brief Moves random nodes between random directories on several threads, some with a new name. Meanwhile one thread renames
+ * random nodes to a few shared names and another one creates and deletes files. Afterwards the tree must still contain every node exactly once.
+ * One operation are all moves.
+ */
+static void BenchMoveStress()
+{
+	const size_t THREADS = 4;
+	size_t Dirs = 64;
+	size_t Moves = Scaled(20000);
+
+	VFS::CVFS vfs;
+	for (size_t i = 0; i < Dirs; i++)
+	{
+		vfs.CreateDir("/dir" + to_string(i));
+		for (size_t j = 0; j < 4; j++)
+			vfs.Open("/dir" + to_string(i) + "/file" + to_string(j), VFS::FileMode::WRITE);
+	}
+
+	bool Ran = false;
+	atomic<size_t> Created(0), Deleted(0);
+	Run("move_stress", "threads=" + to_string(THREADS) + " nodes=" + to_string(Dirs * 5) + " moves=" + to_string(Moves), 1, [&](size_t)
+	{
+		Ran = true;
+		vector<thread> Threads;
+
+		//Reuses names, so a path of a move may refer to another node when the move changes the tree.
+		Threads.emplace_back([&]()
+		{
+			uint64_t Seed = THREADS + 1;
+			for (size_t i = 0; i < Moves / THREADS; i++)
+			{
+				string From = RandomPath(vfs, Seed, false);
+				try
+				{
+					vfs.Rename(From, "r" + to_string((Seed >> 40) % 8));
+				}
+				catch(const VFS::CVFSException &)
+				{
+				}
+			}
+		});
+
+		//The names of the new files are unique, so a path either refers to the created file or to nothing.
+		Threads.emplace_back([&]()
+		{
+			uint64_t Seed = THREADS + 2;
+			vector<string> Files;
+			for (size_t i = 0; i < Moves / THREADS; i++)
+			{
+				if(i % 2 == 0)
+				{
+					string Path = RandomPath(vfs, Seed, true);
+					Path = (Path == "/" ? "" : Path) + "/tmp" + to_string(i);
+					try
+					{
+						if(vfs.Open(Path, VFS::FileMode::WRITE))
+						{
+							Files.push_back(Path);
+							Created++;
+						}
+					}
+					catch(const VFS::CVFSException &)
+					{
+					}
+				}
+				else if(!Files.empty())
+				{
+					Seed = Seed * 6364136223846793005ULL + 1442695040888963407ULL;
+					size_t Pos = (Seed >> 33) % Files.size();
+					try
+					{
+						vfs.Delete(Files[Pos]);
+						Deleted++;
+					}
+					catch(const VFS::CVFSException &)
+					{
+						//Moved meanwhile.
+					}
+
+					Files.erase(Files.begin() + Pos);
+				}
+			}
+		});
+
+		for (size_t t = 0; t < THREADS; t++)
+		{
+			Threads.emplace_back([&, t]()
+			{
+				uint64_t Seed = t + 1;
+				for (size_t i = 0; i < Moves / THREADS; i++)
+				{
+					string From = RandomPath(vfs, Seed, false);
+					string To = RandomPath(vfs, Seed, true);
+					string Name = i % 4 == 0 ? "moved" + to_string(t) + "_" + to_string(i) : "";
+
+					try
+					{
+						vfs.Move(From, To, Name);
+					}
+					catch(const VFS::CVFSException &)
+					{
+						//Moves into the node itself, name collisions and nodes which are moved meanwhile are rejected.
+					}
+				}
+			});
+		}
+
+		for (auto &&e : Threads)
+			e.join();
+	});
+
+	unordered_set<VFS::CVFSNode*> Seen;
+	if(Ran && CheckTree(vfs, vfs.GetNodeInfo("/"), Seen) != Dirs * 5 + Created - Deleted)
+	{
+		cerr << "move_stress: nodes lost" << endl;
+		abort();
+	}
+}
+
+/**
+ * @brief Measures and compacts trees, which files waste the tail of their last chunk. The retained bytes of compact are the released memory.
+ */
+static void BenchCompact()
+{
+	size_t Ops = Scaled(10);
+	vector<unique_ptr<VFS::CVFS>> Trees;
+	for (size_t i = 0; i < Ops; i++)
+	{
+		Trees.push_back(unique_ptr<VFS::CVFS>(new VFS::CVFS()));
+		Populate(*Trees.back(), "/data", 10, 100, 5000);
+	}
+
+	Run("memory_report", "files=1000 size=5000", Ops, [&](size_t i)
+	{
+		Trees[i]->MemoryReport();
+	});
+
+	Run("compact", "files=1000 size=5000", Ops, [&](size_t i)
+	{
+		Trees[i]->Compact();
+	}, 1000 * 5000);
+}
+
+static void BenchSerialize()
+{
+	for (size_t Dirs : {Scaled(1), Scaled(10), Scaled(100)})
+	{
+		VFS::CVFS vfs;
+		Populate(vfs, "/data", Dirs, 100, 1000);
+
+		string Params = "files=" + to_string(Dirs * 100) + " size=1000";
+		vector<char> Image;
+		Run("serialize", Params, 10, [&](size_t)
+		{
+			Image = vfs.Serialize();
+		}, vfs.Serialize().size());
+
+		Run("deserialize", Params, 10, [&](size_t)
+		{
+			VFS::CVFS Tmp;
+			Tmp.Deserialize(Image);
+		}, Image.size());
+
+		Run("deserialize_lazy", Params, 10, [&](size_t)
+		{
+			VFS::CVFS Tmp;
+			Tmp.Deserialize(Image, VFS::VFSVerify::LAZY);
+		}, Image.size());
+	}
+}
+
+#ifdef CVFS_HAS_FILESYSTEM
+/**
+ * @brief Imports and exports a host tree of Dirs directories with 100 files each.
+ */
+static void BenchHostTree()
+{
+	namespace fs = std::filesystem;
+	for (size_t Dirs : {Scaled(10), Scaled(100)})
+	{
+		fs::path Root = fs::temp_directory_path() / ("vfs_bench_" + to_string(Dirs));
+		fs::remove_all(Root);
+
+		string Data(4096, 'x');
+		for (size_t i = 0; i < Dirs; i++)
+		{
+			fs::path Dir = Root / ("dir" + to_string(i));
+			fs::create_directories(Dir);
+
+			for (size_t j = 0; j < 100; j++)
+				ofstream(Dir / ("file" + to_string(j)), ios::binary) << Data;
+		}
+
+		string Params = "files=" + to_string(Dirs * 100) + " size=4096";
+		VFS::CVFS vfs;
+		Run("import_tree", Params, 5, [&](size_t i)
+		{
+			vfs.ImportTree(Root.string(), "/import" + to_string(i));
+		}, Dirs * 100 * Data.size());
+
+		fs::remove_all(Root);
+		Run("export_tree", Params, 5, [&](size_t i)
+		{
+			vfs.ExportTree("/import" + to_string(i), (Root / to_string(i)).string());
+		}, Dirs * 100 * Data.size());
+
+		fs::remove_all(Root);
+	}
+}
+#endif
+
+/**
+ * @brief Read only stream over memory, so reading the archive costs one copy like a pipe.
+ */
+struct SMemoryBuf : streambuf
+{
+	SMemoryBuf(const string &Data)
+	{
+		char *Begin = (char*)Data.data();
+		setg(Begin, Begin, Begin + Data.size());
+	}
+};
+
+/**
+ * @brief Stream which only counts the written bytes.
+ */
+struct SNullBuf : streambuf
+{
+	streamsize xsputn(const char*, streamsize Count) override
+	{
+		return Count;
+	}
+
+	int overflow(int c) override
+	{
+		return traits_type::not_eof(c);
+	}
+};
+
+/**
+ * @brief Streams a tree out as tar archive and imports the archive.
+ * The baseline of the import copies the archive into new buffers of the file size, which is the least an import has to do.
+ */
+static void BenchTar()
+{
+	size_t Dirs = Scaled(4);
+	size_t Size = 1024 * 1024;
+	VFS::CVFS vfs;
+	Populate(vfs, "/src", Dirs, 16, Size);
+
+	string Params = "files=" + to_string(Dirs * 16) + " size=" + to_string(Size);
+	Run("export_tar", Params, 5, [&](size_t)
+	{
+		SNullBuf Buf;
+		ostream Stream(&Buf);
+		vfs.ExportTar("/src", Stream);
+	}, Dirs * 16 * Size);
+
+	ostringstream Out;
+	vfs.ExportTar("/src", Out);
+	string Archive = Out.str();
+
+	//The buffers are kept like the imported files.
+	vector<unique_ptr<char[]>> Buffers;
+	Run("import_tar_memcpy", Params, 5, [&](size_t)
+	{
+		for (size_t i = 0; i + Size <= Archive.size(); i += Size)
+		{
+			Buffers.emplace_back(new char[Size]);
+			memcpy(Buffers.back().get(), Archive.data() + i, Size);
+		}
+	}, Archive.size());
+
+	Buffers.clear();
+
+	Run("import_tar", Params, 5, [&](size_t i)
+	{
+		SMemoryBuf Buf(Archive);
+		istream Stream(&Buf);
+		vfs.ImportTar(Stream, "/import" + to_string(i));
+	}, Archive.size());
+}
+
+#ifdef CVFS_HAS_SHARED_MEMORY
+/**
+ * @brief Writes and reads small files of a shared memory filesystem.
+ */
+static void BenchShared()
+{
+	const string Name = "/vfs_bench_shared";
+	VFS::CSharedVFS::Remove(Name);
+	{
+		VFS::CSharedVFS vfs(Name, 256 * 1024 * 1024);
+		vfs.CreateDir("/data");
+
+		string Data(64, 'x');
+		size_t Ops = Scaled(100000);
+		Run("shared_write_small", "size=64", Ops, [&](size_t i)
+		{
+			vfs.Write("/data/file" + to_string(i % 1000), Data);
+		}, Data.size());
+
+		Run("shared_access_small", "size=64", Ops, [&](size_t i)
+		{
+			vfs.Access("/data/file" + to_string(i % 1000), [](const char *, uint64_t Size)
+			{
+				if(Size != 64)
+					abort();
+			});
+		}, Data.size());
+	}
+
+	VFS::CSharedVFS::Remove(Name);
+}
+#endif
+
+/**
+ * @brief Runs the lock heavy hot paths with the given thread policy.
+ */
+template<class FS>
+static void BenchPolicy(const string &Policy)
+{
+	FS vfs;
+	string Deep = Path(8);
+	vfs.CreateDir(Deep, true);
+
+	Run("policy_lookup", "policy=" + Policy + " depth=8", Scaled(200000), [&](size_t)
+	{
+		if(!vfs.GetNodeInfo(Deep))
+			abort();
+	});
+
+	string Data(64, 'x');
+	auto fs = vfs.Open("/file", VFS::FileMode::RW);
+	size_t Ops = Scaled(500000);
+	Run("policy_write_small", "policy=" + Policy + " size=64", Ops, [&](size_t)
+	{
+		fs->Write(Data);
+	}, Data.size());
+
+	vector<char> Buf(Data.size());
+	fs->Seek(VFS::Cursor::BEG, 0);
+	Run("policy_read_small", "policy=" + Policy + " size=64", Ops, [&](size_t)
+	{
+		if(fs->Read(Buf.data(), Buf.size()) != Buf.size())
+			abort();
+	}, Data.size());
+
+	Run("policy_name", "policy=" + Policy, Scaled(1000000), [&](size_t)
+	{
+		if(fs->Name().empty())
+			abort();
+	});
+}
+
+static void BenchThreadPolicy()
+{
+	BenchPolicy<VFS::CVFS>("multi");
+	BenchPolicy<VFS::CSingleThreadedVFS>("single");
+}
+
+static void PrintJSON()
+{
+	cout << "{" << endl;
+	cout << "  \"benchmarks\": [" << endl;
+	for (size_t i = 0; i < g_Results.size(); i++)
+	{
+		auto &e = g_Results[i];
+		cout << "    {\"name\": \"" << e.Name << "\", \"params\": \"" << e.Params << "\", \"ops\": " << e.Ops
+			 << ", \"ops_per_sec\": " << e.OpsPerSec << ", \"p50_ns\": " << e.P50 << ", \"p99_ns\": " << e.P99
+			 << ", \"bytes_per_sec\": " << e.BytesPerSec << ", \"bytes_allocated_per_op\": " << e.BytesPerOp
+			 << ", \"allocations_per_op\": " << e.AllocsPerOp << ", \"retained_bytes_per_op\": " << e.RetainedPerOp << "}" << (i + 1 < g_Results.size() ? "," : "") << endl;
+	}
+
+	cout << "  ]" << endl;
+	cout << "}" << endl;
+}
+
+int main(int argc, char **argv)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		string Arg = argv[i];
+		if(Arg == "--filter" && i + 1 < argc)
+			g_Filter = argv[++i];
+		else if(Arg == "--scale" && i + 1 < argc)
+			g_Scale = atof(argv[++i]);
+		else
+		{
+			cerr << "Usage: vfs_bench [--filter name] [--scale factor]" << endl;
+			return 1;
+		}
+	}
+
+	BenchCreateDir();
+	BenchTinyFiles();
+	BenchLookup();
+	BenchList();
+	BenchWriteRead();
+	BenchAdopt();
+	BenchConcurrentAppend();
+	BenchCapped();
+	BenchReserve();
+	BenchCopy();
+	BenchDelete();
+	BenchMoveStress();
+	BenchCompact();
+	BenchSerialize();
+	BenchTar();
+#ifdef CVFS_HAS_FILESYSTEM
+	BenchHostTree();
+#endif
+#ifdef CVFS_HAS_SHARED_MEMORY
+	BenchShared();
+#endif
+	BenchThreadPolicy();
+
+	PrintJSON();
+	return 0;
+}
@@ -42,19 +42,13 @@ int main()
 	vfs.CreateDir("/tmp/Test");
 
 	//Reads the header file into the filesystem.
-	ifstream in("VFS.hpp", ios::in);
+	ifstream in("VFS.hpp", ios::in | ios::binary);
 	if(in.is_open())
 	{
 		auto fs = vfs.Open("/tmp/VFS.txt", VFS::FileMode::RW);
 
-		while (in.good())
-		{
-			char c;
-			in.read(&c, sizeof(c));
-
-			if(in.good())
-				fs->Write(&c, sizeof(c));
-		}
+		string Data((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+		fs->Write(Data);
 
 		while (!fs->IsEOF())
 		{